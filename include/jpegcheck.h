@@ -0,0 +1,56 @@
+/**
+ * @file jpegcheck.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Marker-level JPEG validation that runs before a frame is decoded.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef __JPEGCHECK_H
+#define __JPEGCHECK_H
+
+#include <stddef.h>
+
+#define JPEGCHECK_SOI 0x1 /// Start of image found
+#define JPEGCHECK_SOF 0x2 /// Frame header found and valid
+#define JPEGCHECK_SOS 0x4 /// Start of scan found
+#define JPEGCHECK_EOI 0x8 /// End of image found
+#define JPEGCHECK_ALL (JPEGCHECK_SOI | JPEGCHECK_SOF | JPEGCHECK_SOS | JPEGCHECK_EOI)
+
+/**
+ * @brief Structure of a JPEG as found by jpegcheck_scan.
+ *
+ */
+typedef struct
+{
+    unsigned int found; /// JPEGCHECK_* markers seen so far
+    int width;          /// image width from the SOF
+    int height;         /// image height from the SOF
+    int ncomp;          /// number of components from the SOF
+    int progressive;    /// SOF2 frame
+    size_t len;         /// length up to and including the EOI, 0 until the EOI is found
+    size_t safe;        /// length libjpeg can decode as a truncated image: all of it, or up to a marker segment that is cut off
+    const char *error;  /// what is wrong with the data, NULL if nothing
+} jpegcheck_info;
+
+/**
+ * @brief Walk the markers of a JPEG without decoding it: SOI first, marker
+ * segments whose lengths stay inside the data, a frame header with sane values
+ * (and the expected size, if given) before the first scan, and an EOI after the
+ * entropy-coded data. Only scan data is searched, with memchr for 0xFF, so a
+ * 640x480 frame is checked in microseconds. The data can be incomplete, e.g.
+ * while it is being received.
+ *
+ * @param jpg JPEG data
+ * @param len Length of the data
+ * @param width Expected width (0 for any)
+ * @param height Expected height (0 for any)
+ * @param info Structure found is stored here
+ * @return int 1 if the JPEG is complete (info->len is its true length), 0 if it is
+ * valid so far but incomplete, negative if it is malformed (see info->error)
+ */
+int jpegcheck_scan(const unsigned char *jpg, size_t len, int width, int height, jpegcheck_info *info);
+
+#endif // __JPEGCHECK_H
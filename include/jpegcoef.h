@@ -0,0 +1,109 @@
+/**
+ * @file jpegcoef.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Work on the quantized DCT coefficients of a JPEG without decoding pixels.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef __JPEGCOEF_H
+#define __JPEGCOEF_H
+
+#include <stdio.h>
+#include <jpeglib.h>
+#include <ucam_arena.h>
+#include <jpegmem.h>
+#include <jpegdec.h>
+#include <ucam_frame.h>
+
+#define JPEGCOEF_ARENA_SZ (2 * 1024 * 1024) /// Coefficients of a 640x480 4:2:0 frame take 900 kiB
+#define JPEGCOEF_SHARP_FREQ 3                /// Lowest DCT frequency (of 0--7) that counts as detail for jpegcoef_sharpness
+
+/**
+ * @brief Coefficient reader. Like jpegdec, one decompress object is created at
+ * init and reused: jpegcoef_read loads the whole coefficient array of a JPEG into
+ * the arena, the analysis functions work on it, and jpegcoef_done releases it.
+ *
+ */
+typedef struct
+{
+    struct jpeg_decompress_struct cinfo; /// decompress object kept across frames
+    jpegdec_err jerr;                    /// error manager that returns instead of exiting
+    jpegmem mem;                         /// arena-backed memory manager of cinfo
+    jvirt_barray_ptr *coefs;             /// coefficient array of each component, NULL when no image is loaded
+    unsigned char *out;                  /// thumbnail from jpegcoef_thumb
+    size_t out_sz;                       /// capacity of out in bytes
+    int width;                           /// width of the thumbnail
+    int height;                          /// height of the thumbnail
+    int stride;                          /// bytes per row of the thumbnail
+    unsigned long nerrors;               /// number of images abandoned on a libjpeg error
+} jpegcoef;
+
+/**
+ * @brief Create the decompress object of a coefficient reader.
+ *
+ * @param jc Coefficient reader, memory managed by the caller
+ * @param arena Arena to carve the coefficient arena out of (NULL to map a private one)
+ * @return int Non-negative on success, negative on error
+ */
+int jpegcoef_init(jpegcoef *jc, ucam_arena *arena);
+/**
+ * @brief Read the header and every DCT coefficient of a JPEG, without IDCT,
+ * upsampling or color conversion. An image that is still loaded is released.
+ *
+ * @param jc Coefficient reader
+ * @param jpg JPEG data
+ * @param len Length of JPEG data
+ * @return int Non-negative on success, negative on error
+ */
+int jpegcoef_read(jpegcoef *jc, const unsigned char *jpg, size_t len);
+/**
+ * @brief Build a 1/8 scale image from the DC coefficients alone: every 8x8 block
+ * of the largest component becomes one pixel, and subsampled chroma blocks are
+ * repeated instead of upsampled. 640x480 gives 80x60. The result is in jc->out.
+ *
+ * @param jc Coefficient reader with an image loaded
+ * @param format JPEGDEC_RGBX, JPEGDEC_RGB or JPEGDEC_GRAY
+ * @return int Non-negative on success, negative on error
+ */
+int jpegcoef_thumb(jpegcoef *jc, jpegdec_format format);
+/**
+ * @brief Score how sharp an image is from the dequantized AC coefficients of its
+ * first (luminance) component, without decoding pixels. For the horizontal and
+ * the vertical frequencies separately, the share of AC energy at frequencies of
+ * JPEGCOEF_SHARP_FREQ and above is computed, and the smaller share is the score.
+ * It does not depend on brightness or contrast, and motion blur along either
+ * direction lowers it. Scores compare frames taken at the same quality setting.
+ *
+ * @param jc Coefficient reader with an image loaded
+ * @param sharpness Score from 0 (flat or blurred) to 1 is stored here
+ * @return int Non-negative on success, negative on error
+ */
+int jpegcoef_sharpness(jpegcoef *jc, double *sharpness);
+/**
+ * @brief Luminance histogram from the DC coefficients of the Y (or gray)
+ * component: the mean of every 8x8 block, without IDCT or color conversion.
+ * Costs a pass over one coefficient per block once the image is loaded, and is
+ * what exposure decisions need.
+ *
+ * @param jc Coefficient reader with a YCbCr or grayscale image loaded
+ * @param luma Statistics are stored here
+ * @return int Non-negative on success, negative on error
+ */
+int jpegcoef_luma(jpegcoef *jc, ucam_luma *luma);
+/**
+ * @brief Release the image loaded by jpegcoef_read.
+ *
+ * @param jc Coefficient reader
+ */
+void jpegcoef_done(jpegcoef *jc);
+/**
+ * @brief Destroy the decompress object and release the thumbnail buffer.
+ *
+ * @param jc Coefficient reader
+ */
+void jpegcoef_destroy(jpegcoef *jc);
+
+#endif // __JPEGCOEF_H
@@ -0,0 +1,250 @@
+/**
+ * @file jpegdec.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Long-lived JPEG decoder that keeps its libjpeg state and buffers across frames.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef __JPEGDEC_H
+#define __JPEGDEC_H
+
+#include <stdio.h>
+#include <setjmp.h>
+#include <jpeglib.h>
+#include <ucam_arena.h>
+#include <jpegmem.h>
+
+/**
+ * @brief Progress of the image being decoded.
+ *
+ */
+typedef enum
+{
+    JPEGDEC_IDLE = 0, /// no image started, or the last one failed
+    JPEGDEC_HEADER,   /// waiting for the header
+    JPEGDEC_START,    /// waiting for the start of the scan
+    JPEGDEC_SCAN,     /// decoding scanlines
+    JPEGDEC_FINISH,   /// waiting for the end of the image
+    JPEGDEC_DONE,     /// image complete
+} jpegdec_state;
+
+/**
+ * @brief Decode profiles, from fastest to most accurate.
+ *
+ */
+typedef enum
+{
+    JPEGDEC_PREVIEW = 0, /// fast integer IDCT, merged upsampling, no block smoothing
+    JPEGDEC_DISPLAY,     /// accurate integer IDCT, merged upsampling, no block smoothing
+    JPEGDEC_FULL,        /// accurate integer IDCT, fancy upsampling, block smoothing (libjpeg defaults)
+    JPEGDEC_NPROFILES,
+} jpegdec_profile;
+
+#define JPEGDEC_MAX_PLANES 3 /// Planes of raw YCbCr output
+
+/**
+ * @brief Pixel formats libjpeg can produce directly.
+ *
+ */
+typedef enum
+{
+    JPEGDEC_RGBX = 0, /// 4 bytes per pixel, for OpenGL textures
+    JPEGDEC_RGB,      /// 3 bytes per pixel, for storage
+    JPEGDEC_GRAY,     /// 1 byte per pixel, luminance only, chroma is not transformed
+    JPEGDEC_YCBCR,    /// raw Y, Cb and Cr planes at their subsampled sizes, no color conversion or upsampling
+    JPEGDEC_NFORMATS,
+} jpegdec_format;
+
+/**
+ * @brief libjpeg error manager that reports fatal errors to the decoder instead
+ * of exiting. The message goes out through pub.output_message, which callers
+ * can replace to silence or redirect it, and is kept in msg.
+ *
+ */
+typedef struct
+{
+    struct jpeg_error_mgr pub; /// libjpeg error manager, must be the first member
+    jmp_buf env;               /// where fatal errors return to
+    char msg[JMSG_LENGTH_MAX]; /// message of the last fatal error
+} jpegdec_err;
+
+/**
+ * @brief JPEG decoder. One decompress object is created at init and reused for
+ * every frame: per frame only the source, the header and the parameters that
+ * depend on it are set up again, and the output buffer is only reallocated when
+ * the frame does not fit. The source manager suspends when it runs out of data,
+ * so an image can be decoded while it is still being received. Scanlines are
+ * decoded directly into the output buffer through an array of row pointers. A
+ * decoder is used by one thread at a time.
+ *
+ */
+typedef struct
+{
+    struct jpeg_decompress_struct cinfo;       /// decompress object kept across frames, must be the first member
+    jpegdec_err jerr;                          /// libjpeg error manager
+    struct jpeg_source_mgr src;                /// suspending source manager over stream_buf
+    const unsigned char *stream_buf;           /// JPEG data being decoded
+    size_t stream_len;                         /// bytes of stream_buf received so far
+    size_t stream_skip;                        /// bytes libjpeg skipped past the end of the received data
+    int stream_eof;                            /// no more data will arrive
+    jpegdec_state state;                       /// progress of the current image
+    jpegmem mem;                               /// arena-backed memory manager of cinfo
+    ucam_arena *arena;                         /// arena output buffers come from (NULL for heap)
+    jpegdec_profile profile;                   /// speed/quality trade-off, JPEGDEC_FULL after init
+    jpegdec_format format;                     /// pixel format of out, JPEGDEC_RGBX after init
+    int view_w;                                /// on-screen width the output has to cover (0 for native size)
+    int view_h;                                /// on-screen height the output has to cover (0 for native size)
+    unsigned char *out;                        /// output image in the requested format
+    size_t out_sz;                             /// capacity of out in bytes
+    int out_ext;                               /// out belongs to the caller (jpegdec_set_output)
+    JSAMPROW *rows;                            /// row pointers into out handed to libjpeg
+    int rows_cap;                              /// capacity of rows
+    int img_width;                             /// width of the last image as encoded
+    int img_height;                            /// height of the last image as encoded
+    int scale_denom;                           /// the last image was decoded at 1/scale_denom of its size
+    int width;                                 /// width of the last decoded image
+    int height;                                /// height of the last decoded image
+    int stride;                                /// bytes per row of out (of the Y plane for JPEGDEC_YCBCR)
+    int ncomp;                                 /// number of planes (JPEGDEC_YCBCR only)
+    unsigned char *plane[JPEGDEC_MAX_PLANES];  /// start of each plane in out
+    JSAMPARRAY plane_rows[JPEGDEC_MAX_PLANES]; /// row pointers of each plane
+    int plane_w[JPEGDEC_MAX_PLANES];           /// width of each plane in pixels
+    int plane_h[JPEGDEC_MAX_PLANES];           /// height of each plane in pixels
+    int plane_stride[JPEGDEC_MAX_PLANES];      /// bytes per row of each plane, padded to whole DCT blocks
+    int nrows;                                 /// rows of out decoded so far
+    unsigned long nframes;                     /// number of frames decoded
+    unsigned long ngrow;                       /// number of times the output buffer had to grow
+    unsigned long nreads;                      /// number of jpeg_read_scanlines calls
+    unsigned long nerrors;                     /// number of images abandoned on a libjpeg error
+} jpegdec;
+
+/**
+ * @brief Install an error manager that returns to err->env instead of exiting.
+ * Must be called before jpeg_create_*, and every function that calls into
+ * libjpeg sets err->env with setjmp first.
+ *
+ * @param err Error manager, usually a member of the object that owns cinfo
+ * @param cinfo libjpeg compress or decompress object
+ */
+void jpegdec_err_init(jpegdec_err *err, j_common_ptr cinfo);
+/**
+ * @brief Handle a fatal error in the setjmp branch: reattach the memory manager,
+ * keep the message in err->msg and pass it to output_message. The caller still
+ * aborts or destroys cinfo.
+ *
+ * @param err Error manager installed with jpegdec_err_init
+ * @param cinfo libjpeg object the error was raised on
+ * @param mem Memory manager of cinfo
+ */
+void jpegdec_err_caught(jpegdec_err *err, j_common_ptr cinfo, jpegmem *mem);
+/**
+ * @brief Create the decompress object of a decoder.
+ *
+ * @param dec Decoder, memory managed by the caller
+ * @param arena Arena for libjpeg's pools and the output buffer (NULL to map a
+ * private arena for libjpeg and use the heap for output)
+ * @return int Non-negative on success, negative on error
+ */
+int jpegdec_init(jpegdec *dec, ucam_arena *arena);
+/**
+ * @brief Name of a decode profile.
+ *
+ * @param profile jpegdec_profile
+ * @return const char* Name, "unknown" for an invalid profile
+ */
+const char *jpegdec_profile_name(jpegdec_profile profile);
+/**
+ * @brief Name of a pixel format.
+ *
+ * @param format jpegdec_format
+ * @return const char* Name, "unknown" for an invalid format
+ */
+const char *jpegdec_format_name(jpegdec_format format);
+/**
+ * @brief Pick the cheapest DCT scaling, 1/8, 1/4, 1/2 or 1/1, at which an image
+ * still covers the on-screen size in both directions. libjpeg scales these in the
+ * inverse DCT by computing only the low-frequency outputs of each block, so a
+ * smaller output costs less than decoding at full size. Views larger than the
+ * image decode at full size and are left to the texture sampler.
+ *
+ * @param width Width of the image as encoded
+ * @param height Height of the image as encoded
+ * @param view_w Width on screen in pixels, 0 if unknown
+ * @param view_h Height on screen in pixels, 0 if unknown
+ * @return int Scale denominator (1, 2, 4 or 8)
+ */
+int jpegdec_scale_denom(int width, int height, int view_w, int view_h);
+/**
+ * @brief Decode a JPEG held in memory into dec->out, scaled down with
+ * jpegdec_scale_denom to cover dec->view_w x dec->view_h. The result is valid until
+ * the next call.
+ *
+ * @param dec Decoder
+ * @param jpg JPEG data
+ * @param len Length of JPEG data
+ * @return int Non-negative on success, negative on error
+ */
+int jpegdec_decode(jpegdec *dec, const unsigned char *jpg, size_t len);
+/**
+ * @brief Start decoding an image that is still being received into jpg. Data is
+ * made available with jpegdec_stream_feed. An image that was not completed is
+ * abandoned.
+ *
+ * @param dec Decoder
+ * @param jpg Buffer the JPEG is being received into, must not move until the image is done
+ */
+void jpegdec_stream_begin(jpegdec *dec, const unsigned char *jpg);
+/**
+ * @brief Decode as far as the data received so far allows. Header parsing, output
+ * setup and scanlines pick up where the last call ran out of data, and the first
+ * dec->nrows rows of dec->out are final once the output size is known.
+ *
+ * @param dec Decoder
+ * @param len Total number of bytes received into the buffer so far
+ * @param last No more data will arrive, libjpeg fills in
+ * the rest of a truncated image
+ * @return int 1 when the image is complete, 0 when more data is needed, negative
+ * on error. After an error the image is abandoned, but the first dec->nrows rows
+ * of dec->out that were decoded before it are intact.
+ */
+int jpegdec_stream_feed(jpegdec *dec, size_t len, int last);
+/**
+ * @brief Load the tables of a tables-only datastream, for the abbreviated JPEGs
+ * decoded after it. The tables stay loaded until a JPEG redefines them.
+ *
+ * @param dec Decoder
+ * @param tables Tables-only JPEG datastream
+ * @param len Length of the datastream
+ * @return int Non-negative on success, negative on error
+ */
+int jpegdec_tables(jpegdec *dec, const unsigned char *tables, size_t len);
+/**
+ * @brief Decode into a buffer owned by the caller from now on. Images that do not
+ * fit fail instead of growing the buffer. Passing NULL goes back to a buffer
+ * owned by the decoder.
+ *
+ * @param dec Decoder
+ * @param out Output buffer (NULL for the decoder's own)
+ * @param size Capacity of out in bytes
+ */
+void jpegdec_set_output(jpegdec *dec, unsigned char *out, size_t size);
+/**
+ * @brief Destroy the decompress object and release the output buffer.
+ *
+ * @param dec Decoder
+ */
+void jpegdec_destroy(jpegdec *dec);
+/**
+ * @brief Read a JPEG file into memory allocated with malloc.
+ *
+ * @param fname File name
+ * @param jpg Pointer to the data is stored here, to be freed by the caller
+ * @param len Length of the data is stored here
+ * @return int Non-negative on success, negative on error
+ */
+int jpegdec_read_file(const char *fname, unsigned char **jpg, size_t *len);
+
+#endif // __JPEGDEC_H
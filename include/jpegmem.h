@@ -0,0 +1,79 @@
+/**
+ * @file jpegmem.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Arena-backed libjpeg memory manager that is reset, not freed, between frames.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef __JPEGMEM_H
+#define __JPEGMEM_H
+
+#include <stdio.h>
+#include <jpeglib.h>
+#include <ucam_arena.h>
+
+#define JPEGMEM_ARENA_SZ (512 * 1024) /// Default arena size, a 640x480 decode at 1:1 scale peaks under 64 kiB
+
+/**
+ * @brief Memory manager installed in place of libjpeg's own after jpeg_create_*.
+ * Everything in JPOOL_IMAGE, including virtual arrays, is served from the arena,
+ * which is reset when libjpeg frees the image pool at the end of every frame.
+ * JPOOL_PERMANENT requests (a handful of small objects made at create time), and
+ * image requests that do not fit in the arena, are passed on to libjpeg's manager.
+ *
+ */
+typedef struct
+{
+    struct jpeg_memory_mgr pub;        /// Methods seen by libjpeg, must be the first member
+    struct jpeg_memory_mgr *sys;       /// libjpeg's own memory manager
+    ucam_arena arena;                  /// Serves JPOOL_IMAGE
+    struct jvirt_sarray_control *virt_sarray; /// Virtual sample arrays requested since the last reset
+    struct jvirt_barray_control *virt_barray; /// Virtual coefficient arrays requested since the last reset
+    unsigned long n_arena;             /// Number of requests served from the arena
+    unsigned long n_sys;               /// Number of requests passed on to libjpeg's manager
+    unsigned long n_reset;             /// Number of times the arena was reset
+} jpegmem;
+
+/**
+ * @brief Set up the arena of a memory manager. The arena is carved out of parent
+ * if one is given, otherwise it gets its own locked, pre-faulted mapping.
+ *
+ * @param mem Memory manager, memory managed by the caller
+ * @param parent Arena to carve out of (NULL to map a new one)
+ * @param size Size of the arena in bytes
+ * @return int Non-negative on success, negative on error
+ */
+int jpegmem_init(jpegmem *mem, ucam_arena *parent, size_t size);
+/**
+ * @brief Install the memory manager in a libjpeg object. Must be called right
+ * after jpeg_create_compress or jpeg_create_decompress. jpeg_destroy restores
+ * libjpeg's own manager, so the memory manager can be attached again to the
+ * next object.
+ *
+ * @param mem Memory manager set up with jpegmem_init
+ * @param cinfo libjpeg compress or decompress object
+ */
+void jpegmem_attach(jpegmem *mem, j_common_ptr cinfo);
+/**
+ * @brief Put the memory manager back after a fatal libjpeg error. An error raised
+ * inside libjpeg's manager (out of memory) longjmps out while that manager is
+ * swapped in, and every later request would bypass the arena. Call it first in
+ * the setjmp branch, before jpeg_abort or jpeg_destroy; it does nothing if the
+ * memory manager is not attached.
+ *
+ * @param mem Memory manager
+ * @param cinfo libjpeg object the error was raised on
+ */
+void jpegmem_recover(jpegmem *mem, j_common_ptr cinfo);
+/**
+ * @brief Release the arena of the memory manager. Must not be attached to a
+ * libjpeg object at this point.
+ *
+ * @param mem Memory manager
+ */
+void jpegmem_destroy(jpegmem *mem);
+
+#endif // __JPEGMEM_H
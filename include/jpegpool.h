@@ -0,0 +1,134 @@
+/**
+ * @file jpegpool.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Decode service with a fixed pool of worker threads and pooled output buffers.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef __JPEGPOOL_H
+#define __JPEGPOOL_H
+
+#include <pthread.h>
+#include <ucam_arena.h>
+#include <ucam_frame.h>
+#include <jpegdec.h>
+
+#define JPEGPOOL_MAX_WORKERS 16 /// Largest number of worker threads
+
+typedef struct jpegpool_job jpegpool_job;
+
+/**
+ * @brief Called on the worker thread when a job has been decoded (or has failed).
+ *
+ * @param job The job, with the results filled in
+ * @param user User data of the job
+ */
+typedef void (*jpegpool_cb)(jpegpool_job *job, void *user);
+
+/**
+ * @brief A decode request. The memory is managed by the caller and must stay valid,
+ * along with the JPEG data, until the completion callback has run.
+ *
+ */
+struct jpegpool_job
+{
+    const unsigned char *jpg; /// JPEG data
+    size_t len;               /// length of JPEG data
+    int priority;             /// higher runs first, equal priorities run in order of submission
+    jpegdec_format format;    /// output pixel format
+    jpegdec_profile profile;  /// speed/quality trade-off (a zeroed job uses JPEGDEC_PREVIEW)
+    int view_w;               /// on-screen size the output has to cover (0 for native size)
+    int view_h;               /// on-screen size the output has to cover (0 for native size)
+    jpegpool_cb done;         /// completion callback (can be NULL)
+    void *user;               /// user data for done
+    int status;               /// result of jpegdec_decode
+    ucam_frame *out;          /// output buffer from the pool, NULL on error; the job holds one reference
+    int width;                /// width of the decoded image
+    int height;               /// height of the decoded image
+    int stride;               /// bytes per row of out
+    int worker;               /// worker that decoded the job
+    unsigned long long seq;   /// submission order
+};
+
+/**
+ * @brief Argument of a worker thread.
+ *
+ */
+typedef struct
+{
+    void *pool; /// jpegpool the worker belongs to
+    int id;     /// index of the worker
+} jpegpool_worker;
+
+/**
+ * @brief Decode service. Jobs wait in a priority queue and are taken by the
+ * first idle worker that can get an output buffer from the ucam_frame_pool; it
+ * decodes with its own persistent jpegdec straight into that buffer.
+ *
+ */
+typedef struct
+{
+    pthread_t threads[JPEGPOOL_MAX_WORKERS]; /// worker threads
+    jpegdec decs[JPEGPOOL_MAX_WORKERS];      /// decoder of each worker
+    jpegpool_worker workers[JPEGPOOL_MAX_WORKERS]; /// arguments of the worker threads
+    int nworkers;                            /// number of workers
+    ucam_frame_pool bufs;                    /// output buffers
+    jpegpool_job **queue;                    /// binary heap of waiting jobs
+    int qcap;                                /// capacity of the queue
+    int qlen;                                /// number of waiting jobs
+    int busy;                                /// number of jobs being decoded
+    unsigned long long seq;                  /// sequence number of the next job
+    unsigned long ndone;                     /// number of jobs completed
+    int stop;                                /// workers exit once the queue is empty
+    pthread_mutex_t lock;                    /// protects the queue and counters
+    pthread_cond_t work;                     /// signalled when a job is queued, a buffer is released or on stop
+    pthread_cond_t idle;                     /// signalled when a job completes
+} jpegpool;
+
+/**
+ * @brief Start the worker threads and allocate the output buffers.
+ *
+ * @param pool Decode service, memory managed by the caller
+ * @param nworkers Number of worker threads (1 -- JPEGPOOL_MAX_WORKERS)
+ * @param qcap Largest number of jobs that can wait in the queue
+ * @param nbufs Number of output buffers
+ * @param buf_sz Size of each output buffer in bytes
+ * @param arena Arena for the output buffers (NULL for heap)
+ * @return int Non-negative on success, negative on error
+ */
+int jpegpool_init(jpegpool *pool, int nworkers, int qcap, int nbufs, size_t buf_sz, ucam_arena *arena);
+/**
+ * @brief Queue a job.
+ *
+ * @param pool Decode service
+ * @param job Job with the input, priority, output settings and callback set
+ * @return int Non-negative on success, negative if the queue is full or the service is stopping
+ */
+int jpegpool_submit(jpegpool *pool, jpegpool_job *job);
+/**
+ * @brief Give the output buffer of a completed job back to the pool. Idle workers
+ * wait for a free buffer before they take a job, so every buffer has to be
+ * released, with this function rather than ucam_frame_unref so that they wake up.
+ *
+ * @param job Completed job
+ */
+void jpegpool_release(jpegpool_job *job);
+/**
+ * @brief Wait until every submitted job has completed.
+ *
+ * @param pool Decode service
+ */
+void jpegpool_wait(jpegpool *pool);
+/**
+ * @brief Finish the queued jobs, stop the workers, wait until every output
+ * buffer has been released with jpegpool_release, and free them. Jobs the
+ * calling thread still holds have to be released first.
+ *
+ * @param pool Decode service
+ */
+void jpegpool_destroy(jpegpool *pool);
+
+#endif // __JPEGPOOL_H
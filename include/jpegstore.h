@@ -0,0 +1,117 @@
+/**
+ * @file jpegstore.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Background storage of captured frames, rewritten to take less space.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef __JPEGSTORE_H
+#define __JPEGSTORE_H
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <ucam_frame.h>
+#include <jpegxcode.h>
+
+#define JPEGSTORE_PATH_MAX 256 /// Longest file name of a stored frame
+#define JPEGSTORE_MAX_TABLES 8 /// Table sets remembered as written, older ones are written again when they come back
+
+/**
+ * @brief What happened to one stored frame.
+ *
+ */
+typedef struct
+{
+    unsigned long long seq; /// sequence number of the frame
+    ssize_t rcvd;           /// bytes as received
+    size_t len;             /// bytes of JPEG without the padding after the EOI
+    size_t stored;          /// bytes written to disk
+    int status;             /// 1 if rewritten, 0 if stored as is, negative if stored as received after an error
+    double us;              /// time spent rewriting in microseconds
+    int shared;             /// the frame is abbreviated and needs dir/tables_<tables_id>.jpg to decode
+    unsigned int tables_id; /// table set of an abbreviated frame
+    char path[JPEGSTORE_PATH_MAX]; /// file the frame was written to
+} jpegstore_rec;
+
+/**
+ * @brief Called on the storage thread when a frame has been written (or has failed).
+ *
+ * @param rec What happened to the frame
+ * @param user User data given to jpegstore_init
+ */
+typedef void (*jpegstore_cb)(const jpegstore_rec *rec, void *user);
+
+/**
+ * @brief Frame store. Frames are queued by reference, without copies, and a
+ * storage thread rewrites each one with jpegxcode_optimize before writing it
+ * to dir/frame_<seq>.jpg, so capture never waits for the disk or the encoder.
+ * With shared_tables set the quantization tables, which only change with the
+ * resolution and quality setting of the camera, are written once to
+ * dir/tables_<id>.jpg and the frames refer to them by ID. A frame the tables
+ * would not make smaller is stored complete.
+ *
+ */
+typedef struct
+{
+    char dir[JPEGSTORE_PATH_MAX - 32]; /// directory frames are written to, leaves room for the file name
+    jpegxcode xc;                 /// transcoder of the storage thread
+    pthread_t thread;             /// storage thread
+    ucam_frame **queue;           /// ring of frames waiting to be stored
+    int qcap;                     /// capacity of the queue
+    int qhead;                    /// index of the oldest waiting frame
+    int qlen;                     /// number of waiting frames
+    int busy;                     /// a frame is being stored
+    int stop;                     /// the thread exits once the queue is empty
+    int progressive;              /// store progressive JPEGs (see jpegxcode_optimize), picked up with the next frame, set with __atomic_store_n
+    int shared_tables;            /// store abbreviated JPEGs and their table sets separately, picked up with the next frame, set with __atomic_store_n
+    unsigned int tables[JPEGSTORE_MAX_TABLES]; /// IDs of the table sets written last, storage thread only
+    int ntables;                  /// number of table sets written, storage thread only
+    jpegstore_cb done;            /// called for every stored frame (can be NULL)
+    void *user;                   /// user data for done
+    unsigned long nstored;        /// number of frames written
+    unsigned long nerrors;        /// number of frames that could not be rewritten or written
+    unsigned long long bytes_in;  /// bytes received of the frames written
+    unsigned long long bytes_out; /// bytes written
+    pthread_mutex_t lock;         /// protects the queue and counters
+    pthread_cond_t work;          /// signalled when a frame is queued or on stop
+    pthread_cond_t idle;          /// signalled when a frame has been stored
+} jpegstore;
+
+/**
+ * @brief Set up the transcoder and start the storage thread.
+ *
+ * @param store Frame store, memory managed by the caller
+ * @param dir Directory to write frames to, must exist
+ * @param qcap Largest number of frames that can wait to be stored
+ * @param done Called for every stored frame (can be NULL)
+ * @param user User data for done
+ * @return int Non-negative on success, negative on error
+ */
+int jpegstore_init(jpegstore *store, const char *dir, int qcap, jpegstore_cb done, void *user);
+/**
+ * @brief Queue a frame for storage. The store takes its own reference, which it
+ * drops once the frame is written.
+ *
+ * @param store Frame store
+ * @param frame Captured JPEG frame
+ * @return int Non-negative on success, negative if the queue is full or the store is stopping
+ */
+int jpegstore_put(jpegstore *store, ucam_frame *frame);
+/**
+ * @brief Wait until every queued frame has been stored.
+ *
+ * @param store Frame store
+ */
+void jpegstore_wait(jpegstore *store);
+/**
+ * @brief Store the queued frames, stop the storage thread and release the transcoder.
+ *
+ * @param store Frame store
+ */
+void jpegstore_destroy(jpegstore *store);
+
+#endif // __JPEGSTORE_H
@@ -0,0 +1,137 @@
+/**
+ * @file jpegxcode.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Rewrite captured JPEGs in the DCT coefficient domain, without decoding pixels.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef __JPEGXCODE_H
+#define __JPEGXCODE_H
+
+#include <stdio.h>
+#include <jpeglib.h>
+#include <ucam_arena.h>
+#include <jpegmem.h>
+#include <jpegdec.h>
+#include <jpegcoef.h>
+#include <jpegcheck.h>
+
+#define JPEGXCODE_MAX_SCALE 3200 /// Coarsest requantization tried, in percent of the original tables
+#define JPEGXCODE_MAX_PASSES 8   /// Encoding passes of the search for the scale (and band) that fits a budget
+#define JPEGXCODE_TABLES_MARKER (JPEG_APP0 + 11) /// Marker naming the table set of an abbreviated frame
+#define JPEGXCODE_TABLES_TAG "uCAM-T"           /// Identifier at the start of the marker, followed by the 32 bit set ID
+
+/**
+ * @brief Coefficient transcoder. A coefficient reader and a compress object are
+ * created at init and reused: the coefficients of a frame are read once and can
+ * be written out again as often as needed. Both objects use jpegmem, whose
+ * virtual arrays the compress object reads from the reader directly.
+ *
+ */
+typedef struct
+{
+    jpegcoef coef;                      /// reads the coefficients of the frame being rewritten
+    struct jpeg_compress_struct cinfo;  /// compress object kept across frames, must not move after init
+    jpegdec_err jerr;                   /// error manager that returns instead of exiting
+    jpegmem mem;                        /// arena-backed memory manager of cinfo
+    struct jpeg_destination_mgr dest;   /// destination manager writing into out
+    JHUFF_TBL std_dc[2];                /// standard DC Huffman tables for jpegxcode_fit, libjpeg keeps optimized ones across frames
+    JHUFF_TBL std_ac[2];                /// standard AC Huffman tables
+    unsigned char *out;                 /// the rewritten JPEG
+    size_t out_sz;                      /// capacity of out in bytes
+    size_t out_len;                     /// length of the rewritten JPEG
+    size_t in_len;                      /// length of the last input, without padding for jpegxcode_optimize
+    JBLOCK *orig;                       /// coefficients as read, requantization starts from these
+    size_t orig_sz;                     /// capacity of orig in blocks
+    int progressive;                    /// jpegxcode_optimize writes progressive JPEGs, 0 after init
+    int shared_tables;                  /// jpegxcode_optimize leaves the quantization tables out of the JPEG, 0 after init
+    unsigned char *tables;              /// tables-only datastream of the last shared-table output
+    size_t tables_sz;                   /// capacity of tables in bytes
+    size_t tables_len;                  /// length of the tables-only datastream
+    unsigned int tables_id;             /// hash of the tables-only datastream that names it
+    unsigned char *fit;                 /// best fitting output of jpegxcode_fit while the search goes on
+    size_t fit_sz;                      /// capacity of fit in bytes
+    size_t fit_len;                     /// length of the output in fit
+    int fit_scale;                      /// scale of the output in fit
+    int fit_band;                       /// band of the output in fit
+    int scale;                          /// tables of the last output, in percent of the original
+    int band;                           /// zig-zag coefficients of every block kept in the last output, DCTSIZE2 unless dropped to fit
+    int npasses;                        /// encoding passes made for the last frame
+    unsigned long nframes;              /// number of frames rewritten
+    unsigned long nerrors;              /// number of frames abandoned on a libjpeg error
+} jpegxcode;
+
+/**
+ * @brief Create the coefficient reader and the compress object of a transcoder.
+ *
+ * @param xc Transcoder, memory managed by the caller
+ * @param arena Arena to carve the libjpeg arenas out of (NULL to map private ones)
+ * @return int Non-negative on success, negative on error
+ */
+int jpegxcode_init(jpegxcode *xc, ucam_arena *arena);
+/**
+ * @brief Requantize a JPEG so that it fits a byte budget. Every quantization
+ * table is multiplied by the same scale and each coefficient is rounded to the
+ * nearest step of its coarser table, so nothing is decoded to pixels. The scale
+ * is binary-searched on a log scale between 1x and JPEGXCODE_MAX_SCALE, and the
+ * finest scale that fits wins. Levels of 1 round to 0 from 2x on, so the size
+ * drops in a step there and the result can land well under budget. If even
+ * JPEGXCODE_MAX_SCALE does not fit, the AC coefficients of every block are
+ * dropped from the highest zig-zag index down, and the widest band that fits
+ * wins (xc->band). Both searches together make at most JPEGXCODE_MAX_PASSES
+ * encoding passes. A frame that fits already is copied unchanged. The result
+ * is in xc->out.
+ *
+ * @param xc Transcoder
+ * @param jpg JPEG data
+ * @param len Length of JPEG data
+ * @param target Byte budget
+ * @return int 1 if the result fits, 0 if it does not fit even with the DC
+ * coefficients alone or the passes ran out (xc->out holds the last attempt),
+ * negative on error
+ */
+int jpegxcode_fit(jpegxcode *xc, const unsigned char *jpg, size_t len, size_t target);
+/**
+ * @brief Rewrite a JPEG losslessly with Huffman tables optimized for its own
+ * coefficients. Bytes after the EOI, left over from package reassembly, are
+ * dropped. Markers other than the image's tables are not copied. If the
+ * rewritten JPEG is not smaller, the original without padding is kept. With
+ * xc->progressive set the JPEG is always rewritten, as a progressive JPEG whose
+ * first scan holds the DC of every block, so a transfer cut short still decodes
+ * to the whole frame at lower quality. With xc->shared_tables set the JPEG is
+ * rewritten as an abbreviated datastream without quantization tables, which go
+ * to xc->tables; the Huffman tables are still optimized for every frame. A
+ * JPEGXCODE_TABLES_MARKER in the JPEG names them by xc->tables_id; feed them to
+ * the decoder first (jpegdec_tables). Frames of one resolution and quality share
+ * a table set. Unless xc->progressive is set too, an abbreviated JPEG that is not
+ * smaller than the original is dropped for the complete original, and 0 is
+ * returned. The result is in xc->out.
+ *
+ * @param xc Transcoder
+ * @param jpg JPEG data
+ * @param len Length of JPEG data, padding included
+ * @return int 1 if the JPEG was rewritten, 0 if the original was kept, negative
+ * if it is not a complete JPEG or on error
+ */
+int jpegxcode_optimize(jpegxcode *xc, const unsigned char *jpg, size_t len);
+/**
+ * @brief Find the table set an abbreviated JPEG written by jpegxcode_optimize
+ * refers to.
+ *
+ * @param jpg JPEG data
+ * @param len Length of JPEG data
+ * @param id ID of the table set is stored here
+ * @return int 1 if the JPEG names a table set, 0 if not, negative if it is not a JPEG
+ */
+int jpegxcode_tables_id(const unsigned char *jpg, size_t len, unsigned int *id);
+/**
+ * @brief Destroy the libjpeg objects and release the buffers of a transcoder.
+ *
+ * @param xc Transcoder
+ */
+void jpegxcode_destroy(jpegxcode *xc);
+
+#endif // __JPEGXCODE_H
@@ -12,6 +12,8 @@
 #define __UCAM_III_H
 
 #include <stdio.h>
+#include <ucam_frame.h>
+#include <ucam_stats.h>
 
 /** 
  * @brief Custom assert function to check if struct sizes are accurate.
@@ -240,6 +242,11 @@ extern unsigned char ucam_baud_div1[];
  * 
  */
 extern unsigned char ucam_baud_div2[];
+/**
+ * @brief Baud rate in bits per second, indexed by ucam_baud
+ * 
+ */
+extern unsigned int ucam_baud_rate[];
 
 typedef enum
 {
@@ -267,6 +274,17 @@ typedef enum
     UCAM_SEND_CMD_ERR = 0xff,
 } ucam_errno;
 
+/**
+ * @brief Called after every JPEG package has been received and acknowledged, so
+ * the data can be consumed while the camera sends the next package.
+ * 
+ * @param data Buffer the JPEG is being received into
+ * @param rcvd Bytes received so far
+ * @param size Size of the JPEG announced by the camera
+ * @param user User data passed with the callback
+ */
+typedef void (*ucam_pkg_cb)(const unsigned char *data, ssize_t rcvd, ssize_t size, void *user);
+
 /**
  * @brief This structure contains the serial interface, reset GPIO pin and 
  * operational parameters of the UCAM-III camera.
@@ -289,8 +307,9 @@ typedef struct
     unsigned char brightness;   /// brightness (0--4, 2 is nominal)
     unsigned char exposure;     /// exposure (0--4, goes -2 to 2)
     unsigned char light;        /// 0x0 => 50 Hz hum, 0x1 => 60 Hz hum
+    ucam_jpg_stats jpg_stats;   /// size and transfer time statistics of captured JPEGs
 } ucam;
-const int x = sizeof(ucam);
+static const int x __attribute__((unused)) = sizeof(ucam);
 /**
  * @brief Initialize serial port connection to an UCAM-III camera at serial port
  * specified.
@@ -335,6 +354,67 @@ int ucam_snap_picture(ucam *dev, ssize_t *len);
  * @return int length on success
  */
 int ucam_get_data(ucam *dev, unsigned char *data, ssize_t len, unsigned char err_check);
+/**
+ * @brief Snap a picture of the type specified in the device config, recording the
+ * settings in effect and the time of the snapshot in the frame. The length of
+ * the image is stored in frame->len.
+ * 
+ * @param dev ucam device descriptor
+ * @param frame Frame the picture will be stored in
+ * @return int length of the snapped image, negative on error
+ */
+int ucam_snap_frame(ucam *dev, ucam_frame *frame);
+/**
+ * @brief Get data after snapping the picture with ucam_snap_frame, recording
+ * arrival times of the first and last byte, package count, retries and checksum
+ * status in the frame.
+ * 
+ * @param dev ucam device descriptor
+ * @param frame Frame from ucam_snap_frame
+ * @param err_check Enable error checking for JPEG data
+ * @return int length on success
+ */
+int ucam_get_frame(ucam *dev, ucam_frame *frame, unsigned char err_check);
+/**
+ * @brief ucam_get_frame, calling cb after every JPEG package.
+ * 
+ * @param dev ucam device descriptor
+ * @param frame Frame from ucam_snap_frame
+ * @param err_check Enable error checking for JPEG data
+ * @param cb Package callback (can be NULL)
+ * @param user User data for cb
+ * @return int length on success
+ */
+int ucam_get_frame_stream(ucam *dev, ucam_frame *frame, unsigned char err_check, ucam_pkg_cb cb, void *user);
+/**
+ * @brief Get a live RAW picture (GET PICTURE of type UCAM_RAW, no snapshot) in
+ * the format and resolution set with UCAM_INIT. RAW data comes in a single
+ * block instead of packages, so this is the cheapest frame the camera can send:
+ * 4800 bytes for GRAY8 at UCAM_RAW_W80H60.
+ * 
+ * @param dev ucam device descriptor, configured for a RAW format
+ * @param frame Frame the picture is stored in, with settings and timestamps
+ * @return int length on success, negative on error
+ */
+int ucam_get_raw_frame(ucam *dev, ucam_frame *frame);
+/**
+ * @brief Buffer size that will hold a JPEG at the configured resolution with high
+ * probability, based on the sizes of frames captured so far. Use it to size
+ * frame pools.
+ * 
+ * @param dev ucam device descriptor
+ * @return size_t Buffer size in bytes
+ */
+size_t ucam_frame_size_hint(ucam *dev);
+/**
+ * @brief Estimate how long capturing a JPEG at the configured resolution, baud
+ * rate and package size will take, before starting the capture.
+ * 
+ * @param dev ucam device descriptor
+ * @param p99_ms Estimate for a p99 sized frame is stored here (can be NULL)
+ * @return double Estimate for a mean sized frame in milliseconds
+ */
+double ucam_estimate_xfer(ucam *dev, double *p99_ms);
 /**
  * @brief Soft reset the camera.
  * 
@@ -358,6 +438,40 @@ int ucam_hard_rst(ucam *dev);
  */
 void ucam_destroy(ucam *dev);
 
+/**
+ * @brief Retrieve a JPEG from the camera into mem. Assumes 512 byte packages and
+ * a buffer large enough for the image size announced by the camera; use
+ * camera_Jpg_frame to check against the buffer capacity.
+ * 
+ * @param stream Serial port descriptor
+ * @param mem Memory the JPEG will be stored in
+ * @param debug Print debug messages
+ * @return int length of the JPEG, negative on error
+ */
 int camera_Jpg(int stream, unsigned char* mem, int debug);
+/**
+ * @brief Retrieve a JPEG into a frame, using the package size in the device
+ * config (64 -- 512 bytes) and checking against the capacity of the frame.
+ * Records the settings in effect, timestamps, package count, retries and
+ * checksum status.
+ * 
+ * @param dev ucam device descriptor
+ * @param frame Frame the JPEG will be stored in
+ * @param debug Print debug messages
+ * @return int length of the JPEG, negative on error
+ */
+int camera_Jpg_frame(ucam *dev, ucam_frame *frame, int debug);
+/**
+ * @brief camera_Jpg_frame, calling cb after every package so the JPEG can be
+ * decoded while it is being received.
+ * 
+ * @param dev ucam device descriptor
+ * @param frame Frame the JPEG will be stored in
+ * @param cb Package callback (can be NULL)
+ * @param user User data for cb
+ * @param debug Print debug messages
+ * @return int length of the JPEG, negative on error
+ */
+int camera_Jpg_stream(ucam *dev, ucam_frame *frame, ucam_pkg_cb cb, void *user, int debug);
 
 #endif // __UCAM_III_H
\ No newline at end of file
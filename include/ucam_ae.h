@@ -0,0 +1,86 @@
+/**
+ * @file ucam_ae.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Closed-loop auto-exposure over the contrast, brightness and exposure settings.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef __UCAM_AE_H
+#define __UCAM_AE_H
+
+#include <stdio.h>
+#include <ucam_frame.h>
+
+#define UCAM_AE_NLEVELS 9      /// Exposure levels: exposure 0--4 first, then brightness 0--1 below and 3--4 above
+#define UCAM_AE_NOMINAL 4      /// Level of exposure 2, brightness 2
+#define UCAM_AE_STEP_EV 0.5f   /// Assumed change of the mean luminance per level, in stops
+#define UCAM_AE_TARGET 118.0f  /// Default mean luminance to aim for
+#define UCAM_AE_DEADBAND 0.25f /// Default error in stops below which nothing changes
+#define UCAM_AE_GAIN 0.6f      /// Default fraction of the measured error corrected per frame
+#define UCAM_AE_CLIP 0.05f     /// Fraction of clipped (crushed) blocks that forces a step down (up)
+#define UCAM_AE_WIDE 0.02f     /// Fraction of both clipped and crushed blocks that lowers the contrast
+#define UCAM_AE_NARROW 0.002f  /// Fraction of both below which the contrast goes back to nominal
+
+/**
+ * @brief Auto-exposure controller. Every frame's luminance statistics move a
+ * fractional exposure level by a damped share of the error, in stops, between
+ * the mean and the target; the settings change only when the rounded level
+ * does. Frames captured with settings other than the current ones are still
+ * in flight from before the last change and are skipped, so the loop never
+ * reacts twice to one error.
+ *
+ */
+typedef struct
+{
+    float target;             /// mean luminance to aim for (0--255)
+    float deadband;           /// error in stops below which the level does not move
+    float gain;               /// share of the error corrected per frame (0--1), lower is slower but steadier
+    float level;              /// fractional exposure level (0--UCAM_AE_NLEVELS - 1)
+    float err;                /// error of the last frame used, in stops, positive if too dark
+    unsigned char contrast;   /// contrast to apply (0--4, 2 is nominal)
+    unsigned char brightness; /// brightness to apply (0--4, 2 is nominal)
+    unsigned char exposure;   /// exposure to apply (0--4, 2 is nominal)
+    unsigned long nframes;    /// frames used
+    unsigned long nskipped;   /// frames skipped, captured with older settings or without statistics
+    unsigned long nchanges;   /// number of times the settings changed
+} ucam_ae;
+
+/**
+ * @brief Start the controller from the settings the camera has now.
+ *
+ * @param ae Controller
+ * @param contrast Contrast in effect (0--4)
+ * @param brightness Brightness in effect (0--4)
+ * @param exposure Exposure in effect (0--4)
+ */
+void ucam_ae_init(ucam_ae *ae, unsigned char contrast, unsigned char brightness, unsigned char exposure);
+/**
+ * @brief Map an exposure level to brightness and exposure settings. Exposure
+ * moves first; brightness only once exposure is at either end.
+ *
+ * @param level Exposure level (0--UCAM_AE_NLEVELS - 1)
+ * @param brightness Brightness is stored here
+ * @param exposure Exposure is stored here
+ */
+void ucam_ae_settings(int level, unsigned char *brightness, unsigned char *exposure);
+/**
+ * @brief Feed the luminance statistics of a frame to the controller.
+ *
+ * @param ae Controller
+ * @param frame Frame with luma measured and the settings it was captured with
+ * @return int 1 if the settings in ae changed and have to be sent with UCAM_CBE,
+ * 0 if not, negative if the frame was skipped
+ */
+int ucam_ae_update(ucam_ae *ae, const ucam_frame *frame);
+/**
+ * @brief Print the state of the controller.
+ *
+ * @param ae Controller
+ * @param fp Output stream
+ */
+void ucam_ae_print(const ucam_ae *ae, FILE *fp);
+
+#endif // __UCAM_AE_H
@@ -0,0 +1,135 @@
+/**
+ * @file ucam_arena.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Locked, pre-faulted memory arena for capture and decode buffers.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef __UCAM_ARENA_H
+#define __UCAM_ARENA_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#define UCAM_ARENA_PREFAULT 0x1 /// Touch every page of the arena at init
+#define UCAM_ARENA_LOCK 0x2     /// mlock() the arena so it is never paged out
+#define UCAM_ARENA_HUGEPAGE 0x4 /// Ask for transparent huge pages (MADV_HUGEPAGE)
+#define UCAM_ARENA_ALL (UCAM_ARENA_PREFAULT | UCAM_ARENA_LOCK | UCAM_ARENA_HUGEPAGE)
+
+#define UCAM_ARENA_ALIGN 64 /// Alignment of every allocation handed out by the arena
+
+/**
+ * @brief Page fault counters as reported by getrusage().
+ *
+ */
+typedef struct
+{
+    long minflt; /// minor page faults (no I/O)
+    long majflt; /// major page faults (required I/O)
+} ucam_pgfault;
+
+/**
+ * @brief Bump allocator over a single mapping that is allocated once, pre-faulted,
+ * locked in memory and backed by transparent huge pages where available.
+ *
+ * Allocations are never freed individually; the arena is rewound to a mark or
+ * reset as a whole. An arena is not thread safe: give every thread its own
+ * sub-arena (ucam_arena_sub) carved out at setup time.
+ *
+ */
+typedef struct
+{
+    unsigned char *base;    /// start of usable memory
+    size_t size;            /// usable size in bytes
+    size_t used;            /// bytes currently handed out
+    size_t peak;            /// high watermark of used
+    void *map;              /// mapping owned by this arena (NULL for a sub-arena)
+    size_t map_size;        /// length of the mapping
+    int flags;              /// UCAM_ARENA_* flags requested at init
+    int locked;             /// 1 if the mapping is mlock()ed
+    int huge;               /// 1 if MADV_HUGEPAGE was accepted
+    ucam_pgfault flt_init;  /// page faults taken while setting up the arena
+} ucam_arena;
+
+/**
+ * @brief Map, pre-fault and lock a new arena. Failure to lock or to obtain huge
+ * pages is not fatal; the corresponding field in the arena is left at 0.
+ *
+ * @param arena Arena descriptor, memory managed by the caller
+ * @param size Usable size of the arena in bytes
+ * @param flags Combination of UCAM_ARENA_* flags
+ * @return int Non-negative on success, negative on error
+ */
+int ucam_arena_init(ucam_arena *arena, size_t size, int flags);
+/**
+ * @brief Carve a sub-arena out of a parent arena. The sub-arena shares the
+ * parent's mapping and is released when the parent is reset or destroyed.
+ *
+ * @param parent Arena to allocate from
+ * @param child Sub-arena descriptor, memory managed by the caller
+ * @param size Usable size of the sub-arena in bytes
+ * @return int Non-negative on success, negative if the parent is exhausted
+ */
+int ucam_arena_sub(ucam_arena *parent, ucam_arena *child, size_t size);
+/**
+ * @brief Allocate memory from the arena, aligned to UCAM_ARENA_ALIGN.
+ *
+ * @param arena Arena to allocate from
+ * @param size Number of bytes
+ * @return void* Pointer to memory, NULL if the arena is exhausted
+ */
+void *ucam_arena_alloc(ucam_arena *arena, size_t size);
+/**
+ * @brief Get the current position of the arena, to be passed to ucam_arena_rewind.
+ *
+ * @param arena Arena descriptor
+ * @return size_t Current mark
+ */
+size_t ucam_arena_mark(ucam_arena *arena);
+/**
+ * @brief Release every allocation made after the mark was taken.
+ *
+ * @param arena Arena descriptor
+ * @param mark Mark obtained from ucam_arena_mark
+ */
+void ucam_arena_rewind(ucam_arena *arena, size_t mark);
+/**
+ * @brief Release every allocation in the arena. Memory stays mapped and locked.
+ *
+ * @param arena Arena descriptor
+ */
+void ucam_arena_reset(ucam_arena *arena);
+/**
+ * @brief Unlock and unmap the arena. Does nothing for a sub-arena apart from
+ * clearing the descriptor.
+ *
+ * @param arena Arena descriptor
+ */
+void ucam_arena_destroy(ucam_arena *arena);
+/**
+ * @brief Print usage, lock/huge page status and setup page faults of the arena.
+ *
+ * @param arena Arena descriptor
+ * @param fp Output stream
+ */
+void ucam_arena_report(ucam_arena *arena, FILE *fp);
+/**
+ * @brief Sample the page fault counters of the calling thread (or process, where
+ * per-thread accounting is unavailable). Sample before and after a transfer on
+ * the same thread to verify that the transfer took no faults.
+ *
+ * @param flt Counters are stored here
+ */
+void ucam_pgfault_sample(ucam_pgfault *flt);
+/**
+ * @brief Page faults taken since a sample was stored in start.
+ *
+ * @param start Sample taken with ucam_pgfault_sample
+ * @param delta Faults since start are stored here
+ */
+void ucam_pgfault_since(const ucam_pgfault *start, ucam_pgfault *delta);
+
+#endif // __UCAM_ARENA_H
@@ -0,0 +1,76 @@
+/**
+ * @file ucam_flicker.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Detection of 50/60 Hz light flicker from row banding in low resolution frames.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef __UCAM_FLICKER_H
+#define __UCAM_FLICKER_H
+
+#include <stdio.h>
+
+#define UCAM_FLICKER_MAX_ROWS 128  /// Most rows of a frame used, taller frames are rejected
+#define UCAM_FLICKER_LINE_US 66.7f /// Default sensor line time in microseconds (VGA at 30 fps, 500 lines per frame)
+#define UCAM_FLICKER_MIN_FIT 0.3f  /// Share of the row variance a banding frequency has to explain
+#define UCAM_FLICKER_MARGIN 1.5f   /// How much better it has to fit than the other frequency
+#define UCAM_FLICKER_VOTES 3       /// Frames in a row that have to agree before the setting changes
+
+/**
+ * @brief Flicker detector. Lamps on 50 (60) Hz mains flicker at 100 (120) Hz,
+ * and the rolling shutter turns that into horizontal bands with a period of
+ * 1 / (2 f) divided by the line time. The camera is not synchronized to the
+ * mains, so the bands move from frame to frame while the scene does not: the
+ * ratio of the row means of two consecutive frames cancels the scene and leaves
+ * the banding. A sinusoid is fitted to it at both periods, and the light setting
+ * follows the one that fits, once enough frames agree.
+ *
+ */
+typedef struct
+{
+    float line_us;                     /// sensor line time in microseconds
+    float prev[UCAM_FLICKER_MAX_ROWS]; /// row means of the previous frame
+    int nrows;                         /// rows in prev, 0 if there is no previous frame
+    unsigned char prev_light;          /// light setting the previous frame was captured with
+    float fit[2];                      /// share of the variance of the last row ratio explained at 100 and 120 Hz
+    int detected;                      /// light of the banding seen in the last frames, -1 if none
+    int votes;                         /// frames in a row that saw detected
+    unsigned char light;               /// light setting to apply: 0x0 => 50 Hz, 0x1 => 60 Hz
+    unsigned long nframes;             /// frames compared
+    unsigned long nchanges;            /// number of times the setting changed
+} ucam_flicker;
+
+/**
+ * @brief Start the detector from the light setting the camera has now.
+ *
+ * @param fl Detector
+ * @param light Light setting in effect
+ */
+void ucam_flicker_init(ucam_flicker *fl, unsigned char light);
+/**
+ * @brief Feed a grayscale frame to the detector, a RAW GRAY8 frame or the DC
+ * thumbnail of a JPEG. Rows are averaged, so small frames cost next to nothing.
+ *
+ * @param fl Detector
+ * @param pix Pixels
+ * @param width Width in pixels
+ * @param height Height in pixels, at most UCAM_FLICKER_MAX_ROWS
+ * @param stride Bytes per row
+ * @param lines_per_row Sensor lines each row covers (480 / height for a frame scaled from VGA)
+ * @param light Light setting the frame was captured with
+ * @return int 1 if fl->light changed and has to be sent with UCAM_LIGHT, 0 if not,
+ * negative if the frame could not be used
+ */
+int ucam_flicker_update(ucam_flicker *fl, const unsigned char *pix, int width, int height, int stride, float lines_per_row, unsigned char light);
+/**
+ * @brief Print the state of the detector.
+ *
+ * @param fl Detector
+ * @param fp Output stream
+ */
+void ucam_flicker_print(const ucam_flicker *fl, FILE *fp);
+
+#endif // __UCAM_FLICKER_H
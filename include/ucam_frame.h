@@ -0,0 +1,172 @@
+/**
+ * @file ucam_frame.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Reference-counted frame descriptors carrying capture metadata.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef __UCAM_FRAME_H
+#define __UCAM_FRAME_H
+
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <ucam_arena.h>
+
+/**
+ * @brief Checksum status of a transfer.
+ *
+ */
+typedef enum
+{
+    UCAM_CKSUM_NONE, /// checksum was not verified
+    UCAM_CKSUM_PASS, /// every package passed
+    UCAM_CKSUM_FAIL, /// at least one package failed, see ucam_frame.cksum_err
+} ucam_cksum_status;
+
+#define UCAM_LUMA_NBINS 64 /// Bins of the luminance histogram, 4 levels each
+#define UCAM_LUMA_CLIP 248 /// Blocks with a mean luminance at or above this count as clipped highlights
+#define UCAM_LUMA_CRUSH 8  /// Blocks with a mean luminance at or below this count as crushed shadows
+
+/**
+ * @brief Luminance statistics of a frame, one sample per 8x8 block.
+ *
+ */
+typedef struct
+{
+    unsigned int hist[UCAM_LUMA_NBINS]; /// number of blocks per mean luminance bin
+    unsigned int nblocks;               /// number of blocks, 0 if the frame was not measured
+    float mean;                         /// mean luminance (0--255)
+    float clipped;                      /// fraction of blocks at or above UCAM_LUMA_CLIP
+    float crushed;                      /// fraction of blocks at or below UCAM_LUMA_CRUSH
+} ucam_luma;
+
+/**
+ * @brief A captured frame and everything known about how it was captured.
+ *
+ * Frames come from a ucam_frame_pool and are reference counted, so that decode,
+ * display, storage and analysis consumers can share one buffer without copies.
+ * Every consumer that holds on to a frame takes a reference with ucam_frame_ref
+ * and drops it with ucam_frame_unref; the frame goes back to its pool when the
+ * last reference is dropped. Consumers must treat data as read-only.
+ *
+ */
+typedef struct ucam_frame
+{
+    unsigned char *data;      /// frame data
+    ssize_t len;              /// length of valid data in bytes
+    size_t cap;               /// capacity of data in bytes
+    struct timespec t_snap;   /// CLOCK_MONOTONIC time the picture was requested
+    struct timespec t_first;  /// CLOCK_MONOTONIC time the first byte of data arrived
+    struct timespec t_last;   /// CLOCK_MONOTONIC time the last byte of data arrived
+    unsigned char img_fmt;    /// ucam_img_fmt in effect
+    unsigned char raw_res;    /// ucam_raw_res in effect
+    unsigned char jpg_res;    /// ucam_jpg_res in effect
+    unsigned char pic_mode;   /// ucam_pic_type in effect
+    unsigned char contrast;   /// contrast in effect (0--4)
+    unsigned char brightness; /// brightness in effect (0--4)
+    unsigned char exposure;   /// exposure in effect (0--4)
+    unsigned char light;      /// 0x0 => 50 Hz hum, 0x1 => 60 Hz hum
+    unsigned short pkg_sz;    /// package size in effect
+    int npkg;                 /// number of packages received
+    int retries;              /// read/write retries during the transfer
+    int cksum;                /// ucam_cksum_status
+    int cksum_err;            /// number of packages that failed the checksum
+    float sharpness;          /// jpegcoef_sharpness score (0--1), negative if not scored
+    ucam_luma luma;           /// luminance statistics from jpegcoef_luma
+    unsigned long long seq;   /// sequence number assigned by the pool
+    int refcnt;               /// number of references held, use ucam_frame_ref/ucam_frame_unref
+    void *pool;               /// pool the frame belongs to
+    struct ucam_frame *next;  /// next free frame in the pool
+} ucam_frame;
+
+/**
+ * @brief Fixed set of frames with buffers of equal capacity, allocated once.
+ *
+ */
+typedef struct
+{
+    ucam_frame *frames;       /// array of frame descriptors
+    int nframes;              /// number of frames in the pool
+    size_t cap;               /// capacity of every frame buffer
+    ucam_frame *free_list;    /// frames not referenced by anyone
+    int nfree;                /// number of frames in the free list
+    unsigned long long seq;   /// sequence number of the next frame handed out
+    int heap;                 /// 1 if memory came from the heap and has to be freed
+    pthread_mutex_t lock;     /// protects the free list
+} ucam_frame_pool;
+
+/**
+ * @brief Set up a pool of frames. Descriptors and buffers come from the arena if
+ * one is given, otherwise from the heap.
+ *
+ * @param pool Pool descriptor, memory managed by the caller
+ * @param nframes Number of frames
+ * @param cap Capacity of every frame buffer in bytes
+ * @param arena Arena to allocate from (NULL for heap)
+ * @return int Non-negative on success, negative on error
+ */
+int ucam_frame_pool_init(ucam_frame_pool *pool, int nframes, size_t cap, ucam_arena *arena);
+/**
+ * @brief Release the memory of the pool. Every frame must have been released.
+ *
+ * @param pool Pool descriptor
+ */
+void ucam_frame_pool_destroy(ucam_frame_pool *pool);
+/**
+ * @brief Get an unused frame from the pool, with its metadata cleared and one
+ * reference held by the caller.
+ *
+ * @param pool Pool descriptor
+ * @return ucam_frame* Frame, NULL if every frame is in use
+ */
+ucam_frame *ucam_frame_get(ucam_frame_pool *pool);
+/**
+ * @brief Take an additional reference to a frame.
+ *
+ * @param frame Frame descriptor
+ * @return ucam_frame* The same frame, for convenience
+ */
+ucam_frame *ucam_frame_ref(ucam_frame *frame);
+/**
+ * @brief Drop a reference to a frame, returning it to its pool on the last one.
+ *
+ * @param frame Frame descriptor
+ */
+void ucam_frame_unref(ucam_frame *frame);
+/**
+ * @brief Store the current CLOCK_MONOTONIC time.
+ *
+ * @param ts Time is stored here
+ */
+void ucam_frame_stamp(struct timespec *ts);
+/**
+ * @brief Time in microseconds between two timestamps.
+ *
+ * @param start Earlier timestamp
+ * @param end Later timestamp
+ * @return double end - start in microseconds
+ */
+double ucam_frame_elapsed(const struct timespec *start, const struct timespec *end);
+/**
+ * @brief Image size of a ucam_raw_res.
+ *
+ * @param raw_res ucam_raw_res
+ * @param width Width in pixels is stored here
+ * @param height Height in pixels is stored here
+ * @return int Non-negative on success, negative for an unknown resolution
+ */
+int ucam_frame_raw_dims(unsigned char raw_res, int *width, int *height);
+/**
+ * @brief Print the metadata of a frame.
+ *
+ * @param frame Frame descriptor
+ * @param fp Output stream
+ */
+void ucam_frame_print(const ucam_frame *frame, FILE *fp);
+
+#endif // __UCAM_FRAME_H
@@ -0,0 +1,104 @@
+/**
+ * @file ucam_stack.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Registration and stacking of GRAY8 bursts for noise reduction.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef __UCAM_STACK_H
+#define __UCAM_STACK_H
+
+#include <stdio.h>
+#include <ucam_frame.h>
+
+#define UCAM_STACK_MAX_W 160                                      /// Widest RAW frame (ucam_raw_res)
+#define UCAM_STACK_MAX_H 128                                      /// Tallest RAW frame
+#define UCAM_STACK_MAX_NPIX (UCAM_STACK_MAX_W * UCAM_STACK_MAX_H) /// Largest RAW frame the stack holds
+#define UCAM_STACK_MAX_FRAMES 64                                  /// Most frames in a stack, 64 x 255 still fits in 16 bits
+#define UCAM_STACK_MAX_SHIFT 8                                    /// Default largest translation searched, in pixels
+#define UCAM_STACK_MAD_RATIO 1.5f                                 /// Default ratio to the difference noise alone explains above which an aligned frame is dropped
+
+/**
+ * @brief Burst stack. The first frame is the reference; every other frame is
+ * aligned to it by an integer translation and added in. The translation is
+ * found from the row and column sums of the frames, which costs one pass over
+ * the pixels, and refined by the sum of absolute differences over the center of
+ * the frame. Frames that do not match after alignment (the scene moved, not the
+ * camera) are dropped: the noise of the reference is estimated from the
+ * reference alone, which sets the difference two aligned frames would show if
+ * only noise told them apart, and a frame is measured against that rather than a
+ * fixed level. The limit follows the light and is the same for every frame of
+ * the burst, whatever the order. The sums are 16 bit, and every loop over pixels
+ * goes in blocks of 16 so that the compiler vectorizes it (SSE2 on x86, NEON on
+ * the Pi).
+ *
+ * A frame costs well under a millisecond, so a burst is stacked frame by frame
+ * while the next one is on the serial link, and is ready as soon as the last
+ * frame arrives.
+ *
+ */
+typedef struct
+{
+    unsigned short acc[UCAM_STACK_MAX_NPIX]; /// sum of the aligned frames
+    unsigned char cnt[UCAM_STACK_MAX_NPIX];  /// frames that cover each pixel, fewer near the edges
+    unsigned char ref[UCAM_STACK_MAX_NPIX];  /// reference frame
+    unsigned int ref_col[UCAM_STACK_MAX_W];  /// column sums of the reference
+    unsigned int ref_row[UCAM_STACK_MAX_H];  /// row sums of the reference
+    unsigned char out[UCAM_STACK_MAX_NPIX];  /// stacked frame, filled in by ucam_stack_finish
+    int width;                               /// width of the frames, 0 until the first frame
+    int height;                              /// height of the frames
+    int max_shift;                           /// largest translation searched, in pixels
+    float mad_ratio;                         /// largest ratio of the difference of a frame to the one noise explains
+    int nframes;                             /// frames in the stack, the reference included
+    int nrejected;                           /// frames dropped
+    int dx;                                  /// horizontal shift of the last frame relative to the reference
+    int dy;                                  /// vertical shift of the last frame relative to the reference
+    float mad;                               /// mean absolute difference of the last frame after alignment
+    float noise;                             /// standard deviation of the noise of the reference
+    float mad_limit;                         /// largest difference of a frame that is added, set from noise
+    double register_us;                      /// mean time spent aligning a frame
+    double accumulate_us;                    /// mean time spent adding a frame
+    double finish_us;                        /// time ucam_stack_finish took
+} ucam_stack;
+
+/**
+ * @brief Set the limits to their defaults and empty the stack.
+ *
+ * @param st Stack
+ */
+void ucam_stack_init(ucam_stack *st);
+/**
+ * @brief Empty the stack for a new burst, keeping the limits.
+ *
+ * @param st Stack
+ */
+void ucam_stack_reset(ucam_stack *st);
+/**
+ * @brief Align a GRAY8 frame to the reference and add it to the stack. The first
+ * frame after ucam_stack_reset becomes the reference.
+ *
+ * @param st Stack
+ * @param frame RAW GRAY8 frame with raw_res and len filled in
+ * @return int 1 if the frame was added, 0 if it was dropped, negative if it is
+ * not a complete GRAY8 frame of the size of the stack or the stack is full
+ */
+int ucam_stack_add(ucam_stack *st, const ucam_frame *frame);
+/**
+ * @brief Average the stack into st->out, width x height pixels with no padding.
+ *
+ * @param st Stack
+ * @return int Number of frames averaged, negative if the stack is empty
+ */
+int ucam_stack_finish(ucam_stack *st);
+/**
+ * @brief Print the state and per frame timing of the stack.
+ *
+ * @param st Stack
+ * @param fp Output stream
+ */
+void ucam_stack_print(const ucam_stack *st, FILE *fp);
+
+#endif // __UCAM_STACK_H
@@ -0,0 +1,113 @@
+/**
+ * @file ucam_stats.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Per-resolution JPEG size and transfer time statistics.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef __UCAM_STATS_H
+#define __UCAM_STATS_H
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <ucam_frame.h>
+
+#define UCAM_STATS_BIN 512    /// Width of a size histogram bin in bytes
+#define UCAM_STATS_NBINS 512  /// Number of histogram bins (256 kiB), larger frames land in the last bin
+#define UCAM_STATS_NRES 3     /// Number of ucam_jpg_res values
+
+/**
+ * @brief Running statistics of the frames captured at one JPEG resolution.
+ *
+ */
+typedef struct
+{
+    unsigned long count;                  /// number of frames seen
+    double mean;                          /// mean size in bytes
+    ssize_t max;                          /// largest size in bytes
+    double snap_us;                       /// mean time from request to first byte in microseconds
+    double xfer_us_per_byte;              /// mean time from first to last byte per byte in microseconds
+    unsigned int hist[UCAM_STATS_NBINS];  /// size histogram
+} ucam_size_stats;
+
+/**
+ * @brief Size statistics for every ucam_jpg_res.
+ *
+ */
+typedef struct
+{
+    ucam_size_stats res[UCAM_STATS_NRES]; /// indexed by ucam_stats_index
+} ucam_jpg_stats;
+
+/**
+ * @brief Clear the statistics.
+ *
+ * @param stats Statistics
+ */
+void ucam_stats_init(ucam_jpg_stats *stats);
+/**
+ * @brief Map a ucam_jpg_res to an index in ucam_jpg_stats.res.
+ *
+ * @param jpg_res ucam_jpg_res
+ * @return int Index, negative for an unknown resolution
+ */
+int ucam_stats_index(unsigned char jpg_res);
+/**
+ * @brief Image size of a ucam_jpg_res.
+ *
+ * @param jpg_res ucam_jpg_res
+ * @param width Width in pixels is stored here
+ * @param height Height in pixels is stored here
+ * @return int Non-negative on success, negative for an unknown resolution
+ */
+int ucam_stats_dims(unsigned char jpg_res, int *width, int *height);
+/**
+ * @brief Add a successfully captured JPEG frame to the statistics.
+ *
+ * @param stats Statistics
+ * @param frame Frame with jpg_res, len and timestamps filled in
+ */
+void ucam_stats_update(ucam_jpg_stats *stats, const ucam_frame *frame);
+/**
+ * @brief 99th percentile of the frame size at a resolution.
+ *
+ * @param stats Statistics
+ * @param jpg_res ucam_jpg_res
+ * @return ssize_t Size in bytes (upper edge of the histogram bin), 0 if no frames were seen
+ */
+ssize_t ucam_stats_p99(const ucam_jpg_stats *stats, unsigned char jpg_res);
+/**
+ * @brief Buffer size that will hold a frame at a resolution with high probability:
+ * the larger of the largest frame seen and 1.25 x p99, or a bound derived from
+ * the pixel count until frames have been seen.
+ *
+ * @param stats Statistics
+ * @param jpg_res ucam_jpg_res
+ * @return size_t Buffer size in bytes
+ */
+size_t ucam_stats_bufsz(const ucam_jpg_stats *stats, unsigned char jpg_res);
+/**
+ * @brief Estimate the time from request to last byte of a capture before it starts.
+ * Uses the measured request latency and per-byte transfer time once frames have
+ * been seen, otherwise the time the packages and acknowledgements take on the wire.
+ *
+ * @param stats Statistics
+ * @param jpg_res ucam_jpg_res
+ * @param baud Baud rate in bits per second
+ * @param pkg_sz Package size in bytes
+ * @param p99_ms Estimate for a p99 sized frame is stored here (can be NULL)
+ * @return double Estimate for a mean sized frame in milliseconds
+ */
+double ucam_stats_xfer_ms(const ucam_jpg_stats *stats, unsigned char jpg_res, int baud, unsigned short pkg_sz, double *p99_ms);
+/**
+ * @brief Print the statistics of every resolution that has been seen.
+ *
+ * @param stats Statistics
+ * @param fp Output stream
+ */
+void ucam_stats_print(const ucam_jpg_stats *stats, FILE *fp);
+
+#endif // __UCAM_STATS_H
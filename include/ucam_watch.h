@@ -0,0 +1,96 @@
+/**
+ * @file ucam_watch.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Change detection on low resolution GRAY8 frames that triggers full resolution captures.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef __UCAM_WATCH_H
+#define __UCAM_WATCH_H
+
+#include <stdio.h>
+#include <ucam_frame.h>
+
+#define UCAM_WATCH_MAX_NPIX (160 * 128) /// Largest RAW frame (ucam_raw_res) the background holds
+#define UCAM_WATCH_DELTA 24             /// Default difference from the background, in gray levels, that marks a pixel changed
+#define UCAM_WATCH_ON 0.02f             /// Default fraction of changed pixels that triggers a capture
+#define UCAM_WATCH_OFF 0.005f           /// Default fraction below which the next change can trigger again
+#define UCAM_WATCH_BG_SHIFT 4           /// The background moves 1/16 of the way to every frame
+
+/**
+ * @brief Watch mode change detector. Every low resolution frame is compared to
+ * a running average of the previous ones; once enough pixels differ by more
+ * than delta it asks for a full resolution capture, and it does not ask again
+ * until the scene has settled, so one event costs one full frame. A change that
+ * stays fades into the background in a few dozen frames. The background is kept
+ * in 12.4 fixed point in 16 bits so that difference, threshold, count and update
+ * are one pass of 16 bit lanes the compiler vectorizes (SSE2 on x86, NEON on the Pi).
+ *
+ * Link usage and latency are accounted with ucam_watch_full.
+ *
+ */
+typedef struct
+{
+    short bg[UCAM_WATCH_MAX_NPIX]; /// background in 1/16 gray levels
+    int width;                     /// width of the background, 0 until the first frame
+    int height;                    /// height of the background
+    int delta;                     /// difference in gray levels that marks a pixel changed
+    float on;                      /// fraction of changed pixels that triggers
+    float off;                     /// fraction of changed pixels that re-arms
+    float score;                   /// fraction of changed pixels in the last frame
+    int armed;                     /// the next change triggers a capture
+    unsigned long nframes;         /// low resolution frames compared
+    unsigned long ntriggers;       /// full resolution captures asked for
+    unsigned long nfull;           /// full resolution frames accounted with ucam_watch_full
+    unsigned long long watch_bytes; /// bytes of low resolution frames
+    unsigned long long full_bytes; /// bytes of full resolution frames
+    double watch_us;               /// time spent on low resolution frames, request to last byte
+    double full_us;                /// time spent on full resolution frames, from the end of the triggering frame
+    double latency_us;             /// mean time from the request of the triggering frame to the last byte of the full frame
+    double latency_max_us;         /// longest such time
+    double compare_us;             /// mean time ucam_watch_update spends on a frame
+} ucam_watch;
+
+/**
+ * @brief Set the thresholds to their defaults and clear the background and statistics.
+ *
+ * @param w Detector
+ */
+void ucam_watch_init(ucam_watch *w);
+/**
+ * @brief Compare a GRAY8 frame to the background and fold it in. The first frame,
+ * and a frame of another size, start a new background.
+ *
+ * @param w Detector
+ * @param frame RAW GRAY8 frame with raw_res, len and timestamps filled in
+ * @return int 1 if a full resolution capture should follow, 0 if not, negative
+ * if the frame is not a complete GRAY8 frame
+ */
+int ucam_watch_update(ucam_watch *w, const ucam_frame *frame);
+/**
+ * @brief Account for the full resolution frame captured after a trigger.
+ *
+ * @param w Detector
+ * @param trigger Low resolution frame that triggered
+ * @param full Full resolution frame, with len and timestamps filled in
+ */
+void ucam_watch_full(ucam_watch *w, const ucam_frame *trigger, const ucam_frame *full);
+/**
+ * @brief Fraction of the camera's time that went to full resolution frames.
+ *
+ * @param w Detector
+ * @return double Duty cycle (0--1)
+ */
+double ucam_watch_duty(const ucam_watch *w);
+/**
+ * @brief Print the statistics of the detector.
+ *
+ * @param w Detector
+ * @param fp Output stream
+ */
+void ucam_watch_print(const ucam_watch *w, FILE *fp);
+
+#endif // __UCAM_WATCH_H
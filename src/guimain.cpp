@@ -11,15 +11,26 @@
 extern "C"
 {
 #include <ucam.h>
+#include <ucam_arena.h>
+#include <jpegdec.h>
+#include <jpegcheck.h>
+#include <jpegcoef.h>
+#include <jpegstore.h>
+#include <ucam_ae.h>
+#include <ucam_flicker.h>
+#include <ucam_watch.h>
+#include <ucam_stack.h>
 #include <gpiodev/gpiodev.h>
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <signal.h>
 #include <pthread.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <time.h>
+#include <sys/stat.h>
 }
 
 #include <imgui/imgui.h>
@@ -50,120 +61,43 @@ const ImVec4 IMMGN = ImVec4(1, 0, 1, 1);
 
 #include <jpeglib.h>
 
-// Simple helper function to load an image into a OpenGL texture with common settings
-bool LoadTextureFromFile(const char *filename, GLuint *out_texture, int *out_width, int *out_height)
-{
-    // Load from file
-    int image_width = 0;
-    int image_height = 0;
-    unsigned char *image_data;
-
-    struct jpeg_decompress_struct cinfo;
-    struct jpeg_error_mgr jerr;
-    /* More stuff */
-    FILE *infile;      /* source file */
-    JSAMPARRAY buffer; /* Output row buffer */
-    int row_stride;    /* physical row width in output buffer */
-
-    /* In this example we want to open the input file before doing anything else,
-   * so that the setjmp() error recovery below can assume the file is open.
-   * VERY IMPORTANT: use "b" option to fopen() if you are on a machine that
-   * requires it in order to read binary files.
-   */
-
-    if ((infile = fopen(filename, "rb")) == NULL)
-    {
-        fprintf(stderr, "can't open %s\n", filename);
-        return 0;
-    }
-
-    fprintf(stderr, "%s: %d\n", __func__, __LINE__);
-    cinfo.err = jpeg_std_error(&jerr);
-    /* Step 1: allocate and initialize JPEG decompression object */
-    jpeg_create_decompress(&cinfo);
-    fprintf(stderr, "%s: %d\n", __func__, __LINE__);
-
-    /* Step 2: specify data source (eg, a file) */
-
-    jpeg_stdio_src(&cinfo, infile);
-    fprintf(stderr, "%s: %d\n", __func__, __LINE__);
-    /* Step 3: read file parameters with jpeg_read_header() */
-
-    fprintf(stderr, "%s: %d %d\n", __func__, __LINE__, jpeg_read_header(&cinfo, TRUE));
-    /* We can ignore the return value from jpeg_read_header since
-   *   (a) suspension is not possible with the stdio data source, and
-   *   (b) we passed TRUE to reject a tables-only JPEG file as an error.
-   * See libjpeg.txt for more info.
-   */
-    fprintf(stderr, "%s: %d\n", __func__, __LINE__);
-    /* Step 4: set parameters for decompression */
-
-    /* In this example, we don't need to change any of the defaults set by
-   * jpeg_read_header(), so we do nothing here.
-   */
-
-    /* Step 5: Start decompressor */
-    cinfo.out_color_space = JCS_EXT_RGBX;
-    cinfo.scale_num = 768;
-    cinfo.scale_denom = cinfo.image_height;
-    (void)jpeg_start_decompress(&cinfo);
-    fprintf(stderr, "%s: %d\n", __func__, __LINE__);
-    /* We may need to do some setup of our own at this point before reading
-   * the data.  After jpeg_start_decompress() we have the correct scaled
-   * output image dimensions available, as well as the output colormap
-   * if we asked for color quantization.
-   * In this example, we need to make an output work buffer of the right size.
-   */
-    /* JSAMPLEs per row in output buffer */
-    row_stride = cinfo.output_width * cinfo.output_components;
-    /* Make a one-row-high sample array that will go away when done with image */
-    buffer = (*cinfo.mem->alloc_sarray)((j_common_ptr)&cinfo, JPOOL_IMAGE, row_stride, 1);
-
-    /* Step 6: while (scan lines remain to be read) */
-    /*           jpeg_read_scanlines(...); */
-
-    /* Here we use the library's state variable cinfo.output_scanline as the
-   * loop counter, so that we don't have to keep track ourselves.
-   */
-    image_data = (unsigned char *)malloc(row_stride * cinfo.output_height);
-    image_height = cinfo.output_height;
-    image_width = cinfo.output_width;
-    int loc = 0;
-    fprintf(stderr, "%s: %d: Width = %d, Height = %d Size = %d\n", __func__, __LINE__, cinfo.output_width, cinfo.output_height, row_stride * cinfo.output_height);
-    while (cinfo.output_scanline < cinfo.output_height)
-    {
-        /* jpeg_read_scanlines expects an array of pointers to scanlines.
-     * Here the array is only one element long, but you could ask for
-     * more than one scanline at a time if that's more convenient.
-     */
-        (void)jpeg_read_scanlines(&cinfo, buffer, 1);
-        /* Assume put_scanline_someplace wants a pointer and sample count. */
-        memcpy(&(image_data[loc]), buffer[0], row_stride);
-        loc += row_stride;
-    }
-
-    /* Step 7: Finish decompression */
-
-    (void)jpeg_finish_decompress(&cinfo);
-    fprintf(stderr, "%s: %d\n", __func__, __LINE__);
-    /* We can ignore the return value since suspension is not possible
-   * with the stdio data source.
-   */
-
-    /* Step 8: Release JPEG decompression object */
-
-    /* This is an important step since it will release a good deal of memory. */
-    jpeg_destroy_decompress(&cinfo);
-    fprintf(stderr, "%s: %d\n", __func__, __LINE__);
-    /* After finish_decompress, we can close the input file.
-   * Here we postpone it until after no more JPEG errors are possible,
-   * so as to simplify the setjmp error logic above.  (Actually, I don't
-   * think that jpeg_destroy can do an error exit, but why assume anything...)
-   */
-    fclose(infile);
-    if (image_data == NULL)
-        return false;
+#define GUI_ARENA_SZ (10 * 1024 * 1024) // capture frames + decoders for the camera and the test image + coefficient reader
+
+ucam_arena gui_arena;
+bool gui_arena_active = false;
+ucam_frame_pool gui_frames;
+jpegdec gui_cam_dec;   // decoder for camera frames, used by the capture thread
+jpegdec gui_still_dec; // decoder for stills loaded from disk
+jpegcoef gui_cam_coef; // coefficient reader scoring camera frames, used by the capture thread
+bool gui_cam_coef_active = false;
+ucam_luma gui_cam_luma; // luminance statistics of the last camera frame
+pthread_mutex_t gui_cam_luma_lock = PTHREAD_MUTEX_INITIALIZER; // protects gui_cam_luma
+ucam_ae gui_ae;         // auto-exposure controller, used by the capture thread
+bool auto_exposure = false;
+ucam_flicker gui_flicker; // flicker detector, used by the capture thread
+bool auto_light = false;
+ucam_watch gui_watch; // change detector of watch mode, used by the capture thread
+bool watch_mode = false;
+ucam_stack gui_stack; // burst stack, used by the capture thread
+bool burst_request = false;
+int burst_frames = 8;
+int burst_size = 0; // index into GUI_BURST_SIZES
+#define GUI_BURST_SIZES "80x60\0" "128x96\0" "128x128\0" "160x120\0" // RAW sizes for ImGui::Combo
+static const unsigned char gui_burst_res[] = {UCAM_RAW_W80H60, UCAM_RAW_W128H96, UCAM_RAW_W128H128, UCAM_RAW_W160H120};
+#define GUI_PROFILES "preview\0display\0full\0" // jpegdec_profile names for ImGui::Combo
+int gui_cam_view_w = 0; // size of the image in the camera window in framebuffer pixels, __atomic access
+int gui_cam_view_h = 0;
+int gui_cam_profile = JPEGDEC_PREVIEW; // jpegdec_profile of the live view, picked up by the capture thread, __atomic access
+jpegstore gui_store;         // writes captured frames to GUI_STORE_DIR on its own thread
+bool gui_store_active = false;
+#define GUI_STORE_DIR "frames"
 
+/**
+ * @brief Upload the last image decoded by a decoder into a new OpenGL texture.
+ * 
+ */
+static void UploadTexture(jpegdec *dec, GLuint *out_texture, int *out_width, int *out_height)
+{
     // Create a OpenGL texture identifier
     GLuint image_texture;
     glGenTextures(1, &image_texture);
@@ -175,146 +109,135 @@ bool LoadTextureFromFile(const char *filename, GLuint *out_texture, int *out_wid
 
     // Upload pixels into texture
     glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image_width, image_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image_data);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, dec->width, dec->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, dec->out);
     fprintf(stderr, "%s: %d %d\n", __func__, __LINE__, image_texture);
-    free(image_data);
     *out_texture = image_texture;
-    fprintf(stderr, "%s: %d\n", __func__, __LINE__);
-    *out_width = image_width;
-    fprintf(stderr, "%s: %d\n", __func__, __LINE__);
-    *out_height = image_height;
-    fprintf(stderr, "%s: %d\n", __func__, __LINE__);
-    return true;
+    *out_width = dec->width;
+    *out_height = dec->height;
 }
 
-bool LoadTextureFromMem(const unsigned char *in_jpeg, ssize_t len, GLuint *out_texture, int *out_width, int *out_height)
+/**
+ * @brief Upload a GRAY8 image with no row padding into a new OpenGL texture.
+ *
+ */
+static void UploadGray(const unsigned char *pix, int width, int height, GLuint *out_texture, int *out_width, int *out_height)
 {
-    // Load from file
-    int image_width = 0;
-    int image_height = 0;
-    unsigned char *image_data;
-
-    struct jpeg_decompress_struct cinfo;
-    struct jpeg_error_mgr jerr;
-    /* More stuff */
-    JSAMPARRAY buffer; /* Output row buffer */
-    int row_stride;    /* physical row width in output buffer */
-
-    /* In this example we want to open the input file before doing anything else,
-   * so that the setjmp() error recovery below can assume the file is open.
-   * VERY IMPORTANT: use "b" option to fopen() if you are on a machine that
-   * requires it in order to read binary files.
-   */
-
-    fprintf(stderr, "%s: %d\n", __func__, __LINE__);
-    cinfo.err = jpeg_std_error(&jerr);
-    /* Step 1: allocate and initialize JPEG decompression object */
-    jpeg_create_decompress(&cinfo);
-    fprintf(stderr, "%s: %d\n", __func__, __LINE__);
-
-    /* Step 2: specify data source (eg, a file) */
-
-    jpeg_mem_src(&cinfo, in_jpeg, len);
-    fprintf(stderr, "%s: %d\n", __func__, __LINE__);
-    /* Step 3: read file parameters with jpeg_read_header() */
-
-    fprintf(stderr, "%s: %d %d\n", __func__, __LINE__, jpeg_read_header(&cinfo, TRUE));
-    /* We can ignore the return value from jpeg_read_header since
-   *   (a) suspension is not possible with the stdio data source, and
-   *   (b) we passed TRUE to reject a tables-only JPEG file as an error.
-   * See libjpeg.txt for more info.
-   */
-    fprintf(stderr, "%s: %d\n", __func__, __LINE__);
-    /* Step 4: set parameters for decompression */
-
-    /* In this example, we don't need to change any of the defaults set by
-   * jpeg_read_header(), so we do nothing here.
-   */
-
-    /* Step 5: Start decompressor */
-    cinfo.out_color_space = JCS_EXT_RGBX;
-    cinfo.scale_num = 480; // scale to 480p
-    cinfo.scale_denom = cinfo.image_height;
-    (void)jpeg_start_decompress(&cinfo);
-    fprintf(stderr, "%s: %d\n", __func__, __LINE__);
-    /* We may need to do some setup of our own at this point before reading
-   * the data.  After jpeg_start_decompress() we have the correct scaled
-   * output image dimensions available, as well as the output colormap
-   * if we asked for color quantization.
-   * In this example, we need to make an output work buffer of the right size.
-   */
-    /* JSAMPLEs per row in output buffer */
-    row_stride = cinfo.output_width * cinfo.output_components;
-    /* Make a one-row-high sample array that will go away when done with image */
-    buffer = (*cinfo.mem->alloc_sarray)((j_common_ptr)&cinfo, JPOOL_IMAGE, row_stride, 1);
-
-    /* Step 6: while (scan lines remain to be read) */
-    /*           jpeg_read_scanlines(...); */
-
-    /* Here we use the library's state variable cinfo.output_scanline as the
-   * loop counter, so that we don't have to keep track ourselves.
-   */
-    image_data = (unsigned char *)malloc(row_stride * cinfo.output_height);
-    image_height = cinfo.output_height;
-    image_width = cinfo.output_width;
-    int loc = 0;
-    fprintf(stderr, "%s: %d: Width = %d, Height = %d Size = %d\n", __func__, __LINE__, cinfo.output_width, cinfo.output_height, row_stride * cinfo.output_height);
-    while (cinfo.output_scanline < cinfo.output_height)
-    {
-        /* jpeg_read_scanlines expects an array of pointers to scanlines.
-     * Here the array is only one element long, but you could ask for
-     * more than one scanline at a time if that's more convenient.
-     */
-        (void)jpeg_read_scanlines(&cinfo, buffer, 1);
-        /* Assume put_scanline_someplace wants a pointer and sample count. */
-        memcpy(&(image_data[loc]), buffer[0], row_stride);
-        loc += row_stride;
-    }
-
-    /* Step 7: Finish decompression */
-
-    (void)jpeg_finish_decompress(&cinfo);
-    fprintf(stderr, "%s: %d\n", __func__, __LINE__);
-    /* We can ignore the return value since suspension is not possible
-   * with the stdio data source.
-   */
-
-    /* Step 8: Release JPEG decompression object */
-
-    /* This is an important step since it will release a good deal of memory. */
-    jpeg_destroy_decompress(&cinfo);
-    fprintf(stderr, "%s: %d\n", __func__, __LINE__);
-    /* After finish_decompress, we can close the input file.
-   * Here we postpone it until after no more JPEG errors are possible,
-   * so as to simplify the setjmp error logic above.  (Actually, I don't
-   * think that jpeg_destroy can do an error exit, but why assume anything...)
-   */
-    if (image_data == NULL)
-        return false;
-
-    // Create a OpenGL texture identifier
     GLuint image_texture;
     glGenTextures(1, &image_texture);
     glBindTexture(GL_TEXTURE_2D, image_texture);
-
-    // Setup filtering parameters for display
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    // Upload pixels into texture
     glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image_width, image_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image_data);
-    fprintf(stderr, "%s: %d %d\n", __func__, __LINE__, image_texture);
-    free(image_data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, width, height, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, pix);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
     *out_texture = image_texture;
-    fprintf(stderr, "%s: %d\n", __func__, __LINE__);
-    *out_width = image_width;
-    fprintf(stderr, "%s: %d\n", __func__, __LINE__);
-    *out_height = image_height;
-    fprintf(stderr, "%s: %d\n", __func__, __LINE__);
+    *out_width = width;
+    *out_height = height;
+}
+
+/**
+ * @brief Write a GRAY8 image with no row padding as a binary PGM.
+ *
+ */
+static int SaveGray(const char *fname, const unsigned char *pix, int width, int height)
+{
+    FILE *fp = fopen(fname, "wb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "%s: could not open %s\n", __func__, fname);
+        return -1;
+    }
+    fprintf(fp, "P5\n%d %d\n255\n", width, height);
+    size_t npix = (size_t)width * height;
+    int ret = fwrite(pix, 1, npix, fp) == npix ? 1 : -1;
+    fclose(fp);
+    return ret;
+}
+
+// Simple helper function to load an image into a OpenGL texture with common settings
+bool LoadTextureFromFile(const char *filename, GLuint *out_texture, int *out_width, int *out_height)
+{
+    unsigned char *jpg = NULL;
+    size_t len = 0;
+    if (jpegdec_read_file(filename, &jpg, &len) < 0)
+        return false;
+    jpegcheck_info chk;
+    int ret = jpegcheck_scan(jpg, len, 0, 0, &chk);
+    if (ret < 0 || !(chk.found & JPEGCHECK_SOS))
+    {
+        fprintf(stderr, "%s: %s is not a JPEG: %s\n", __func__, filename, chk.error != NULL ? chk.error : "no scan");
+        free(jpg);
+        return false;
+    }
+    if (ret == 0) // partly downlinked, a progressive file still covers the whole frame
+    {
+        fprintf(stderr, "%s: %s is truncated, decoding %zu of %zu bytes\n", __func__, filename, chk.safe, len);
+        len = chk.safe;
+    }
+    unsigned int tables_id;
+    if (jpegxcode_tables_id(jpg, len, &tables_id) > 0) // stored with shared tables, they are next to the frame
+    {
+        char path[JPEGSTORE_PATH_MAX];
+        const char *slash = strrchr(filename, '/');
+        int dirlen = slash != NULL ? (int)(slash - filename + 1) : 0;
+        snprintf(path, sizeof(path), "%.*stables_%08x.jpg", dirlen, filename, tables_id);
+        unsigned char *tables = NULL;
+        size_t tables_len = 0;
+        if (jpegdec_read_file(path, &tables, &tables_len) < 0 || jpegdec_tables(&gui_still_dec, tables, tables_len) < 0)
+        {
+            fprintf(stderr, "%s: %s needs the tables in %s\n", __func__, filename, path);
+            free(tables);
+            free(jpg);
+            return false;
+        }
+        free(tables);
+    }
+    int status = jpegdec_decode(&gui_still_dec, jpg, len);
+    free(jpg);
+    fprintf(stderr, "%s: %d: Width = %d, Height = %d\n", __func__, __LINE__, gui_still_dec.width, gui_still_dec.height);
+    if (status < 0)
+        return false;
+    UploadTexture(&gui_still_dec, out_texture, out_width, out_height);
     return true;
 }
 
+/**
+ * @brief Camera frame being received and decoded.
+ * 
+ */
+typedef struct
+{
+    jpegdec *dec;        /// decoder fed as packages arrive
+    int width;           /// size expected for the configured resolution
+    int height;          /// size expected for the configured resolution
+    jpegcheck_info chk;  /// structure of the frame
+    bool rejected;       /// the frame failed the check, it is not decoded
+} CamStream;
+
+/**
+ * @brief Package callback of the capture: check the markers of the frame until
+ * the first scan has been seen, and at the end, then decode as much of the frame
+ * as has arrived while the camera sends the next package.
+ * 
+ */
+static void DecodePackage(const unsigned char *data, ssize_t rcvd, ssize_t size, void *user)
+{
+    CamStream *cs = (CamStream *)user;
+    if (cs->rejected)
+        return;
+    if (!(cs->chk.found & JPEGCHECK_SOS) || rcvd >= size)
+    {
+        if (jpegcheck_scan(data, rcvd, cs->width, cs->height, &(cs->chk)) < 0)
+        {
+            cs->rejected = true;
+            return;
+        }
+    }
+    if (cs->dec->state != JPEGDEC_IDLE && cs->dec->state != JPEGDEC_DONE)
+        jpegdec_stream_feed(cs->dec, rcvd, rcvd >= size);
+}
+
 GLuint my_image_texture;
 int my_image_width, my_image_height;
 
@@ -324,6 +247,8 @@ int mmy_image_width, mmy_image_height;
 bool ImageWindowStat = false;
 bool CamWindowStat = false;
 bool enable_camera = false;
+bool store_frames = false;
+float store_min_sharpness = 0; // frames that score lower are not stored
 
 void MainWindow()
 {
@@ -332,43 +257,168 @@ void MainWindow()
     ImGui::Checkbox("Display Image", &ImageWindowStat);
     ImGui::Checkbox("Display Camera", &CamWindowStat);
     ImGui::Checkbox("Enable Camera", &enable_camera);
+    ImGui::SameLine();
+    ImGui::Checkbox("Watch", &watch_mode);
+    if (watch_mode)
+    {
+        ImGui::SameLine();
+        ImGui::Text("score %.3f, %lu full frames, duty cycle %.1f%%, change to frame %.0f ms", gui_watch.score, gui_watch.nfull,
+                    ucam_watch_duty(&gui_watch) * 100, gui_watch.latency_us * 1e-3);
+    }
+    if (ImGui::Button("Burst") && enable_camera && !watch_mode)
+        burst_request = true;
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(100);
+    ImGui::Combo("##burst_size", &burst_size, GUI_BURST_SIZES);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(200);
+    ImGui::SliderInt("Frames", &burst_frames, 2, UCAM_STACK_MAX_FRAMES);
+    if (gui_stack.nframes > 0)
+    {
+        ImGui::SameLine();
+        ImGui::Text("%d stacked, %d dropped, %.0f + %.0f us per frame", gui_stack.nframes, gui_stack.nrejected, gui_stack.register_us, gui_stack.accumulate_us);
+    }
+    if (gui_store_active)
+    {
+        ImGui::Checkbox("Store Frames", &store_frames);
+        ImGui::SameLine();
+        bool progressive = __atomic_load_n(&(gui_store.progressive), __ATOMIC_RELAXED);
+        if (ImGui::Checkbox("Progressive", &progressive))
+            __atomic_store_n(&(gui_store.progressive), (int)progressive, __ATOMIC_RELAXED);
+        ImGui::SameLine();
+        bool shared_tables = __atomic_load_n(&(gui_store.shared_tables), __ATOMIC_RELAXED);
+        if (ImGui::Checkbox("Shared Tables", &shared_tables))
+            __atomic_store_n(&(gui_store.shared_tables), (int)shared_tables, __ATOMIC_RELAXED);
+        if (gui_cam_coef_active)
+            ImGui::SliderFloat("Min Sharpness", &store_min_sharpness, 0.0f, 1.0f, "%.2f");
+        // the storage thread updates the counters together under the lock
+        pthread_mutex_lock(&(gui_store.lock));
+        unsigned long nstored = gui_store.nstored;
+        unsigned long long bytes_in = gui_store.bytes_in, bytes_out = gui_store.bytes_out;
+        pthread_mutex_unlock(&(gui_store.lock));
+        ImGui::SameLine();
+        ImGui::Text("%lu stored, %llu of %llu bytes", nstored, bytes_out, bytes_in);
+    }
     ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
     ImGui::End();
 }
 
+/**
+ * @brief Size at which an image fills the space left in the current window without
+ * changing its aspect ratio. The size in framebuffer pixels, which the decoder has
+ * to cover, is stored in view_w and view_h.
+ *
+ */
+static ImVec2 FitImage(int width, int height, int *view_w, int *view_h)
+{
+    ImVec2 avail = ImGui::GetContentRegionAvail();
+    ImVec2 fb_scale = ImGui::GetIO().DisplayFramebufferScale;
+    float scale = avail.x / width < avail.y / height ? avail.x / width : avail.y / height;
+    if (scale <= 0)
+        scale = 1;
+    ImVec2 size = ImVec2(width * scale, height * scale);
+    *view_w = size.x * fb_scale.x;
+    *view_h = size.y * fb_scale.y;
+    return size;
+}
+
 void ImageWindow(bool *active)
 {
+    ImGui::SetNextWindowSize(ImVec2(800, 600), ImGuiCond_FirstUseEver);
     ImGui::Begin("Image Display", active);
     if (mmy_image_texture != NULL)
     {
         ImGui::Text("pointer = %p", mmy_image_texture);
-        ImGui::Text("size = %d x %d", mmy_image_width, mmy_image_height);
-        ImGui::Image((void *)(intptr_t)mmy_image_texture, ImVec2(mmy_image_width, mmy_image_height));
+        ImGui::Text("size = %d x %d (1/%d of %d x %d)", mmy_image_width, mmy_image_height, gui_still_dec.scale_denom, gui_still_dec.img_width, gui_still_dec.img_height);
+        int profile = gui_still_dec.profile;
+        bool reload = ImGui::Combo("Decode", &profile, GUI_PROFILES);
+        int view_w, view_h;
+        ImVec2 size = FitImage(mmy_image_width, mmy_image_height, &view_w, &view_h);
+        ImGui::Image((void *)(intptr_t)mmy_image_texture, size);
+        // decode the still again when the profile changed or the window was resized across a scale step
+        if (reload || jpegdec_scale_denom(gui_still_dec.img_width, gui_still_dec.img_height, view_w, view_h) != gui_still_dec.scale_denom)
+        {
+            gui_still_dec.profile = (jpegdec_profile)profile;
+            gui_still_dec.view_w = view_w;
+            gui_still_dec.view_h = view_h;
+            glDeleteTextures(1, &mmy_image_texture);
+            mmy_image_texture = 0;
+            LoadTextureFromFile("test.jpeg", &mmy_image_texture, &mmy_image_width, &mmy_image_height);
+        }
     }
     ImGui::End();
 }
 
 void CamWindow(bool *active)
 {
+    ImGui::SetNextWindowSize(ImVec2(660, 540), ImGuiCond_FirstUseEver);
     ImGui::Begin("Camera Display", active);
     if (my_image_texture != NULL)
     {
         ImGui::Text("pointer = %p", my_image_texture);
         ImGui::Text("size = %d x %d", my_image_width, my_image_height);
-        ImGui::Image((void *)(intptr_t)my_image_texture, ImVec2(my_image_width, my_image_height));
+        int profile = __atomic_load_n(&gui_cam_profile, __ATOMIC_RELAXED); // picked up with the next frame
+        if (ImGui::Combo("Decode", &profile, GUI_PROFILES))
+            __atomic_store_n(&gui_cam_profile, profile, __ATOMIC_RELAXED);
+        // picked up by the capture thread when it decodes the next frame
+        int view_w, view_h;
+        ImVec2 size = FitImage(my_image_width, my_image_height, &view_w, &view_h);
+        __atomic_store_n(&gui_cam_view_w, view_w, __ATOMIC_RELAXED);
+        __atomic_store_n(&gui_cam_view_h, view_h, __ATOMIC_RELAXED);
+        ImGui::Image((void *)(intptr_t)my_image_texture, size);
+        // the capture thread replaces the statistics while the window is drawn
+        ucam_luma luma;
+        pthread_mutex_lock(&gui_cam_luma_lock);
+        luma = gui_cam_luma;
+        pthread_mutex_unlock(&gui_cam_luma_lock);
+        if (luma.nblocks > 0)
+        {
+            float hist[UCAM_LUMA_NBINS];
+            for (int i = 0; i < UCAM_LUMA_NBINS; i++)
+                hist[i] = luma.hist[i];
+            ImGui::PlotHistogram("Luminance", hist, UCAM_LUMA_NBINS, 0, NULL, 0.0f, FLT_MAX, ImVec2(size.x, 60));
+            ImGui::Text("mean %.0f, %.1f%% clipped, %.1f%% crushed", luma.mean, luma.clipped * 100, luma.crushed * 100);
+            ImGui::Checkbox("Auto Exposure", &auto_exposure);
+            ImGui::SameLine();
+            ImGui::Text("C/B/E %d/%d/%d, level %.2f, %lu changes", gui_ae.contrast, gui_ae.brightness, gui_ae.exposure, gui_ae.level, gui_ae.nchanges);
+            ImGui::Checkbox("Auto Light", &auto_light);
+            ImGui::SameLine();
+            ImGui::Text("%d Hz, banding fit %.2f at 100 Hz, %.2f at 120 Hz", gui_flicker.light ? 60 : 50, gui_flicker.fit[0], gui_flicker.fit[1]);
+        }
     }
     ImGui::End();
 }
 
+/**
+ * @brief Report how much a stored frame was shrunk, on the storage thread.
+ *
+ */
+static void StoreDone(const jpegstore_rec *rec, void *user)
+{
+    if (rec->stored == 0)
+        fprintf(stderr, "%s: frame %llu not stored\n", __func__, rec->seq);
+    else
+        fprintf(stderr, "%s: %s, %zd -> %zu bytes, %zd saved\n", __func__, rec->path, rec->rcvd, rec->stored, rec->rcvd - (ssize_t)rec->stored);
+}
+
 void *update_image(void *ptr)
 {
     unsigned long long int ctr = 0;
+    bool ae_running = false;
+    bool light_running = false;
+    bool watch_running = false;
+    bool watch_full = false;         // a change was seen, the next frame is a full resolution JPEG
+    unsigned char watch_jpg_res = 0; // JPEG resolution to go back to when watch mode ends
+    ucam_frame trigger;              // metadata of the frame that saw the change
+    unsigned long long nbursts = 0;
     usleep(2000000);
     while (!done)
     {
         if (enable_camera)
         {
-            fprintf(stderr, "%s: In loop %llu, ", __func__, ++ctr);
+            ++ctr;
+            if (!(watch_running && watch_mode)) // watch mode only reports the frames it captures
+                fprintf(stderr, "%s: In loop %llu, ", __func__, ctr);
             // ssize_t len = 0;
             // len = ucam_snap_picture((ucam *)ptr, &len);
             // fprintf(stderr, "snapped picture: length %ld, ", len);
@@ -382,10 +432,213 @@ void *update_image(void *ptr)
             //     free(img_data);
             // }
             // fprintf(stderr, "\n");
-            unsigned char *img_data = (unsigned char *) malloc (2 * 640 * 4800); // max mem size for 640x480 RGB565 image
-            int len = camera_Jpg(((ucam *)ptr)->fd, img_data, 1);
-            LoadTextureFromMem(img_data, len, &my_image_texture, &my_image_width, &my_image_height);
-            free(img_data);
+            ucam *dev = (ucam *)ptr;
+            if (auto_exposure != ae_running)
+            {
+                // start from the settings the camera was given, and make sure it has them
+                if (auto_exposure)
+                {
+                    ucam_ae_init(&gui_ae, dev->contrast, dev->brightness, dev->exposure);
+                    dev->contrast = gui_ae.contrast;
+                    dev->brightness = gui_ae.brightness;
+                    dev->exposure = gui_ae.exposure;
+                    if (ucam_config(dev, UCAM_CBE) < 0)
+                        fprintf(stderr, "could not set contrast/brightness/exposure, ");
+                }
+                ae_running = auto_exposure;
+            }
+            if (auto_light != light_running)
+            {
+                if (auto_light)
+                    ucam_flicker_init(&gui_flicker, dev->light);
+                light_running = auto_light;
+            }
+            if (watch_mode != watch_running)
+            {
+                if (watch_mode)
+                {
+                    ucam_watch_init(&gui_watch);
+                    watch_jpg_res = dev->jpg_res; // full frames are taken at 480p
+                    dev->img_fmt = GRAY8;
+                    dev->raw_res = UCAM_RAW_W80H60;
+                }
+                else
+                {
+                    dev->img_fmt = COL_JPEG;
+                    dev->jpg_res = watch_jpg_res;
+                }
+                if (ucam_config(dev, UCAM_INIT) < 0)
+                    fprintf(stderr, "could not switch to %s frames, ", watch_mode ? "RAW" : "JPEG");
+                if (watch_mode)
+                    fprintf(stderr, "watching\n");
+                watch_running = watch_mode;
+                watch_full = false;
+            }
+            if (burst_request && !watch_running)
+            {
+                // each frame is stacked while the camera sends the next one; the
+                // stack stays on screen and the live view pauses
+                burst_request = false;
+                dev->img_fmt = GRAY8;
+                dev->raw_res = gui_burst_res[burst_size];
+                if (ucam_config(dev, UCAM_INIT) < 0)
+                    fprintf(stderr, "could not switch to RAW frames, ");
+                else
+                {
+                    ucam_stack_reset(&gui_stack);
+                    for (int i = 0; i < burst_frames && !done; i++)
+                    {
+                        ucam_frame *raw = ucam_frame_get(&gui_frames);
+                        if (raw == NULL)
+                            break;
+                        if (ucam_get_raw_frame(dev, raw) > 0 && ucam_stack_add(&gui_stack, raw) == 0)
+                            fprintf(stderr, "burst frame %d does not match, dropped, ", i);
+                        ucam_frame_unref(raw);
+                    }
+                    if (ucam_stack_finish(&gui_stack) > 0)
+                    {
+                        UploadGray(gui_stack.out, gui_stack.width, gui_stack.height, &my_image_texture, &my_image_width, &my_image_height);
+                        if (gui_store_active)
+                        {
+                            char fname[64];
+                            snprintf(fname, sizeof(fname), GUI_STORE_DIR "/stack_%06llu.pgm", ++nbursts);
+                            SaveGray(fname, gui_stack.out, gui_stack.width, gui_stack.height);
+                        }
+                        enable_camera = false;
+                    }
+                    ucam_stack_print(&gui_stack, stderr);
+                }
+                dev->img_fmt = COL_JPEG;
+                if (ucam_config(dev, UCAM_INIT) < 0)
+                    fprintf(stderr, "could not switch to JPEG frames, ");
+                continue;
+            }
+            if (watch_running && !watch_full)
+            {
+                // cheap GRAY8 frames until something changes
+                ucam_frame *raw = ucam_frame_get(&gui_frames);
+                if (raw == NULL)
+                {
+                    fprintf(stderr, "no free frame, skipping\n");
+                    usleep(16000);
+                    continue;
+                }
+                if (ucam_get_raw_frame(dev, raw) > 0 && ucam_watch_update(&gui_watch, raw) > 0)
+                {
+                    fprintf(stderr, "%s: change in %.1f%% of the pixels, capturing a full frame, ", __func__, gui_watch.score * 100);
+                    trigger = *raw;
+                    dev->img_fmt = COL_JPEG;
+                    dev->jpg_res = UCAM_JPG_480p;
+                    watch_full = ucam_config(dev, UCAM_INIT) > 0;
+                }
+                ucam_frame_unref(raw);
+                if (!watch_full) // the score is on screen
+                {
+                    usleep(16000);
+                    continue;
+                }
+            }
+            ucam_frame *frame = ucam_frame_get(&gui_frames);
+            if (frame == NULL)
+            {
+                fprintf(stderr, "no free frame, skipping\n");
+                usleep(16000);
+                continue;
+            }
+            if (ucam_frame_size_hint((ucam *)ptr) > gui_frames.cap)
+                fprintf(stderr, "frames of up to %zu bytes expected, buffers hold %zu, ", ucam_frame_size_hint((ucam *)ptr), gui_frames.cap);
+            fprintf(stderr, "expecting %.0f ms, ", ucam_estimate_xfer((ucam *)ptr, NULL));
+            ucam_pgfault flt_start, flt_xfer, flt_dec;
+            ucam_pgfault_sample(&flt_start);
+            // decode at the smallest scale that covers the camera window as it was last drawn
+            gui_cam_dec.view_w = __atomic_load_n(&gui_cam_view_w, __ATOMIC_RELAXED);
+            gui_cam_dec.view_h = __atomic_load_n(&gui_cam_view_h, __ATOMIC_RELAXED);
+            gui_cam_dec.profile = (jpegdec_profile)__atomic_load_n(&gui_cam_profile, __ATOMIC_RELAXED);
+            CamStream cs;
+            memset(&cs, 0x0, sizeof(CamStream));
+            cs.dec = &gui_cam_dec;
+            ucam_stats_dims(((ucam *)ptr)->jpg_res, &cs.width, &cs.height);
+            jpegdec_stream_begin(&gui_cam_dec, frame->data);
+            int len = camera_Jpg_stream((ucam *)ptr, frame, DecodePackage, &cs, 1);
+            struct timespec t_dec;
+            ucam_frame_stamp(&t_dec);
+            ucam_pgfault_since(&flt_start, &flt_xfer);
+            if (cs.rejected)
+                fprintf(stderr, "rejected frame: %s, ", cs.chk.error);
+            else
+            {
+                if (len > 0 && cs.chk.len > 0 && (ssize_t)cs.chk.len < frame->len)
+                {
+                    fprintf(stderr, "%zd bytes after EOI, ", frame->len - cs.chk.len);
+                    frame->len = cs.chk.len; // true length of the JPEG
+                }
+                if (len > 0 && gui_cam_dec.state == JPEGDEC_DONE)
+                {
+                    fprintf(stderr, "decoded %d x %d, %.0f us after the last byte, ", gui_cam_dec.width, gui_cam_dec.height, ucam_frame_elapsed(&(frame->t_last), &t_dec));
+                    UploadTexture(&gui_cam_dec, &my_image_texture, &my_image_width, &my_image_height);
+                }
+                else if (gui_cam_dec.nrows > 0) // corrupt frame, show the rows decoded before the error
+                {
+                    fprintf(stderr, "corrupt frame, showing %d of %d rows, ", gui_cam_dec.nrows, gui_cam_dec.height);
+                    UploadTexture(&gui_cam_dec, &my_image_texture, &my_image_width, &my_image_height);
+                }
+            }
+            ucam_pgfault_since(&flt_start, &flt_dec);
+            if (gui_cam_coef_active && len > 0 && !cs.rejected && jpegcoef_read(&gui_cam_coef, frame->data, frame->len) > 0)
+            {
+                double sharpness;
+                if (jpegcoef_sharpness(&gui_cam_coef, &sharpness) > 0)
+                    frame->sharpness = sharpness;
+                if (jpegcoef_luma(&gui_cam_coef, &(frame->luma)) > 0)
+                {
+                    pthread_mutex_lock(&gui_cam_luma_lock);
+                    gui_cam_luma = frame->luma;
+                    pthread_mutex_unlock(&gui_cam_luma_lock);
+                }
+                // new settings take effect with the next snapshot
+                if (ae_running && ucam_ae_update(&gui_ae, frame) > 0)
+                {
+                    dev->contrast = gui_ae.contrast;
+                    dev->brightness = gui_ae.brightness;
+                    dev->exposure = gui_ae.exposure;
+                    if (ucam_config(dev, UCAM_CBE) < 0)
+                        fprintf(stderr, "could not set contrast/brightness/exposure, ");
+                    else
+                        ucam_ae_print(&gui_ae, stderr);
+                }
+                // banding shows in the row means of the 1/8 scale thumbnail
+                if (light_running && jpegcoef_thumb(&gui_cam_coef, JPEGDEC_GRAY) > 0 &&
+                    ucam_flicker_update(&gui_flicker, gui_cam_coef.out, gui_cam_coef.width, gui_cam_coef.height, gui_cam_coef.stride,
+                                        480.0f / gui_cam_coef.cinfo.image_height * DCTSIZE, frame->light) > 0)
+                {
+                    dev->light = gui_flicker.light;
+                    if (ucam_config(dev, UCAM_LIGHT) < 0)
+                        fprintf(stderr, "could not set the light frequency, ");
+                    else
+                        ucam_flicker_print(&gui_flicker, stderr);
+                }
+                jpegcoef_done(&gui_cam_coef);
+            }
+            if (store_frames && frame->sharpness >= 0 && frame->sharpness < store_min_sharpness)
+                fprintf(stderr, "blurred frame, not stored, ");
+            else if (store_frames && len > 0 && !cs.rejected && jpegstore_put(&gui_store, frame) < 0)
+                fprintf(stderr, "storage queue full, frame not stored, ");
+            ucam_frame_print(frame, stderr);
+            if (watch_full) // back to watching
+            {
+                if (len > 0)
+                    ucam_watch_full(&gui_watch, &trigger, frame);
+                ucam_watch_print(&gui_watch, stderr);
+                dev->img_fmt = GRAY8;
+                if (ucam_config(dev, UCAM_INIT) < 0)
+                    fprintf(stderr, "could not switch to RAW frames, ");
+                watch_full = false;
+            }
+            ucam_frame_unref(frame);
+            if (ctr % 100 == 0)
+                ucam_stats_print(&(((ucam *)ptr)->jpg_stats), stderr);
+            fprintf(stderr, "page faults: transfer %ld minor %ld major, decode %ld minor %ld major\n",
+                    flt_xfer.minflt, flt_xfer.majflt, flt_dec.minflt - flt_xfer.minflt, flt_dec.majflt - flt_xfer.majflt);
         }
         usleep(16000); // 16 msec, try to get 60 Hz pictures
     }
@@ -415,6 +668,34 @@ int main(int argc, char *argv[])
     }
     ucam_config(&dev, UCAM_INIT);
     ucam_config(&dev, UCAM_SET_PACK_SZ);
+    // Set up the locked arena for capture and decode buffers, the heap is used if this fails
+    if (ucam_arena_init(&gui_arena, GUI_ARENA_SZ, UCAM_ARENA_ALL) > 0)
+    {
+        gui_arena_active = true;
+        ucam_arena_report(&gui_arena, stderr);
+    }
+    // two frames for capture and display, two more can wait for the storage thread
+    if (ucam_frame_pool_init(&gui_frames, 4, ucam_frame_size_hint(&dev), gui_arena_active ? &gui_arena : NULL) < 0)
+    {
+        printf("Failed to allocate frames, exiting\n");
+        return -1;
+    }
+    // decoders keep their decompress objects and output buffers across frames
+    if (jpegdec_init(&gui_cam_dec, gui_arena_active ? &gui_arena : NULL) < 0 ||
+        jpegdec_init(&gui_still_dec, gui_arena_active ? &gui_arena : NULL) < 0)
+    {
+        printf("Failed to set up decoders, exiting\n");
+        return -1;
+    }
+    gui_cam_dec.profile = (jpegdec_profile)gui_cam_profile;
+    gui_still_dec.profile = JPEGDEC_FULL;
+    // frames are scored from their coefficients, without a second decode
+    if (jpegcoef_init(&gui_cam_coef, gui_arena_active ? &gui_arena : NULL) > 0)
+        gui_cam_coef_active = true;
+    ucam_stack_init(&gui_stack);
+    mkdir(GUI_STORE_DIR, 0755);
+    if (jpegstore_init(&gui_store, GUI_STORE_DIR, 2, StoreDone, NULL) > 0)
+        gui_store_active = true;
     // Setup window
     glfwSetErrorCallback(glfw_error_callback);
     if (!glfwInit())
@@ -507,5 +788,17 @@ int main(int argc, char *argv[])
     printf("%s: Hard reset ucam\n", __func__);
     ucam_destroy(&dev);
     printf("%s: Destroyed ucam\n", __func__);
+    jpegdec_destroy(&gui_cam_dec);
+    jpegdec_destroy(&gui_still_dec);
+    if (gui_cam_coef_active)
+        jpegcoef_destroy(&gui_cam_coef);
+    if (gui_store_active)
+        jpegstore_destroy(&gui_store); // writes the frames still queued
+    ucam_frame_pool_destroy(&gui_frames);
+    if (gui_arena_active)
+    {
+        ucam_arena_report(&gui_arena, stderr);
+        ucam_arena_destroy(&gui_arena);
+    }
     return 0;
 }
@@ -0,0 +1,1559 @@
+/**
+ * @file jpegbench.c
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Decode benchmarks on a corpus of synthetic camera frames and stills.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include <jpeglib.h>
+#include <jpegmem.h>
+#include <jpegdec.h>
+#include <jpegcheck.h>
+#include <jpegpool.h>
+#include <jpegcoef.h>
+#include <jpegxcode.h>
+#include <jpegstore.h>
+#include <ucam_ae.h>
+#include <ucam_flicker.h>
+#include <ucam_watch.h>
+#include <ucam_stack.h>
+#include <ucam.h>
+
+#define BENCH_MAX_IMG 16
+#define BENCH_SAMPLES 201 // samples behind a median, independent of -n
+
+/**
+ * @brief A JPEG held in memory, as it would be after a transfer.
+ *
+ */
+typedef struct
+{
+    char name[64];       /// file name or synthetic frame description
+    unsigned char *data; /// JPEG data
+    unsigned long len;   /// length of JPEG data
+} bench_img;
+
+#ifdef __GLIBC__
+/**
+ * @brief Count every heap allocation in the process, including the ones made
+ * inside libjpeg, by interposing malloc.
+ *
+ */
+extern void *__libc_malloc(size_t size);
+static unsigned long bench_nmalloc = 0;
+
+void *malloc(size_t size)
+{
+    __atomic_fetch_add(&bench_nmalloc, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+#define BENCH_NMALLOC() __atomic_load_n(&bench_nmalloc, __ATOMIC_RELAXED)
+#else
+#define BENCH_NMALLOC() 0UL
+#endif
+
+static void bench_quiet(j_common_ptr cinfo)
+{
+}
+
+static inline double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec * 1e-3; // microseconds
+}
+
+/**
+ * @brief Encode a synthetic frame (gradients, edges and noise) so that the corpus
+ * contains frames of the sizes the uCAM-III produces.
+ *
+ */
+static int bench_img_synth(bench_img *img, int width, int height, int quality)
+{
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    unsigned char *row = (unsigned char *)malloc(width * 3);
+    unsigned int seed = width * height;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    img->data = NULL;
+    img->len = 0;
+    jpeg_mem_dest(&cinfo, &(img->data), &(img->len));
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < cinfo.image_height)
+    {
+        int y = cinfo.next_scanline;
+        for (int x = 0; x < width; x++)
+        {
+            int edge = (((x / 40) + (y / 40)) & 0x1) * 64;
+            seed = seed * 1103515245 + 12345;
+            int noise = (seed >> 16) & 0xf;
+            row[3 * x + 0] = (x * 255 / width + edge + noise) & 0xff;
+            row[3 * x + 1] = (y * 255 / height + noise) & 0xff;
+            row[3 * x + 2] = ((x + y) * 127 / (width + height) + edge) & 0xff;
+        }
+        JSAMPROW rows[1] = {row};
+        jpeg_write_scanlines(&cinfo, rows, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    free(row);
+    snprintf(img->name, sizeof(img->name), "synthetic %dx%d", width, height);
+    return 1;
+}
+
+static int bench_img_load(bench_img *img, const char *fname)
+{
+    FILE *fp = fopen(fname, "rb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "%s: Could not open %s\n", __func__, fname);
+        return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    img->len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    img->data = (unsigned char *)malloc(img->len);
+    if (fread(img->data, 1, img->len, fp) != img->len)
+    {
+        fprintf(stderr, "%s: Could not read %s\n", __func__, fname);
+        fclose(fp);
+        free(img->data);
+        return -1;
+    }
+    fclose(fp);
+    snprintf(img->name, sizeof(img->name), "%s", fname);
+    return 1;
+}
+
+/**
+ * @brief Decode one frame with a fresh decompress object, the way the GUI did it
+ * before the persistent decoder. If mem is not NULL the arena-backed manager is
+ * attached, otherwise libjpeg's default manager is used.
+ *
+ */
+static void bench_decode_once(bench_img *img, jpegmem *mem, unsigned char *out, double *setup)
+{
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    double start = bench_now();
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_decompress(&cinfo);
+    if (mem != NULL)
+        jpegmem_attach(mem, (j_common_ptr)&cinfo);
+    jpeg_mem_src(&cinfo, img->data, img->len);
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_EXT_RGBX;
+    jpeg_start_decompress(&cinfo);
+    *setup += bench_now() - start;
+    int row_stride = cinfo.output_width * cinfo.output_components;
+    JSAMPARRAY buffer = (*cinfo.mem->alloc_sarray)((j_common_ptr)&cinfo, JPOOL_IMAGE, row_stride, 1);
+    while (cinfo.output_scanline < cinfo.output_height)
+    {
+        jpeg_read_scanlines(&cinfo, buffer, 1);
+        memcpy(&(out[(cinfo.output_scanline - 1) * row_stride]), buffer[0], row_stride);
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+}
+
+static int bench_cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double bench_median(double *v, int n)
+{
+    qsort(v, n, sizeof(double), bench_cmp_double);
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+/**
+ * @brief Median time to create a decompress object, attach the manager and destroy
+ * it again, without touching a frame.
+ *
+ */
+static double bench_create_median(jpegmem *mem, double *t, int n)
+{
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    for (int s = 0; s < n; s++)
+    {
+        double start = bench_now();
+        cinfo.err = jpeg_std_error(&jerr);
+        jpeg_create_decompress(&cinfo);
+        if (mem != NULL)
+            jpegmem_attach(mem, (j_common_ptr)&cinfo);
+        jpeg_destroy_decompress(&cinfo);
+        t[s] = bench_now() - start;
+    }
+    return bench_median(t, n);
+}
+
+/**
+ * @brief Median per-frame setup (header and start_decompress) on a persistent
+ * decompress object. jpeg_abort_decompress frees the image pool, which resets the
+ * arena the same way finishing the frame does.
+ *
+ */
+static double bench_setup_median(bench_img *img, jpegmem *mem, double *t, int n)
+{
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_decompress(&cinfo);
+    if (mem != NULL)
+        jpegmem_attach(mem, (j_common_ptr)&cinfo);
+    for (int s = 0; s < n; s++)
+    {
+        double start = bench_now();
+        jpeg_mem_src(&cinfo, img->data, img->len);
+        jpeg_read_header(&cinfo, TRUE);
+        cinfo.out_color_space = JCS_EXT_RGBX;
+        jpeg_start_decompress(&cinfo);
+        t[s] = bench_now() - start;
+        jpeg_abort_decompress(&cinfo);
+    }
+    jpeg_destroy_decompress(&cinfo);
+    return bench_median(t, n);
+}
+
+static void bench_memmgr(bench_img *imgs, int nimg, int iters)
+{
+    unsigned char *out = (unsigned char *)malloc(2048 * 2048 * 4);
+    double *t = (double *)malloc(BENCH_SAMPLES * sizeof(double));
+    jpegmem mem;
+    if (jpegmem_init(&mem, NULL, JPEGMEM_ARENA_SZ) < 0)
+        return;
+    printf("\n=== Memory manager: libjpeg default vs arena (%d iterations) ===\n", iters);
+    printf("%-24s %-8s %12s %12s\n", "image", "manager", "malloc/frm", "total us");
+    for (int i = 0; i < nimg; i++)
+    {
+        for (int use_arena = 0; use_arena < 2; use_arena++)
+        {
+            double setup = 0;
+            unsigned long nmalloc = BENCH_NMALLOC();
+            double start = bench_now();
+            for (int it = 0; it < iters; it++)
+                bench_decode_once(&imgs[i], use_arena ? &mem : NULL, out, &setup);
+            double total = bench_now() - start;
+            nmalloc = BENCH_NMALLOC() - nmalloc;
+            printf("%-24s %-8s %12.1f %12.1f\n", imgs[i].name, use_arena ? "arena" : "default",
+                   (double)nmalloc / iters, total / iters);
+        }
+    }
+    // setup is a few microseconds, a mean over a short run is mostly scheduler noise
+    printf("median of %d samples: object = create + attach + destroy, setup = header + start on a persistent object\n",
+           BENCH_SAMPLES);
+    printf("%-24s %-8s %12s %12s\n", "image", "manager", "object us", "setup us");
+    for (int i = 0; i < nimg; i++)
+    {
+        for (int use_arena = 0; use_arena < 2; use_arena++)
+        {
+            jpegmem *m = use_arena ? &mem : NULL;
+            double object = bench_create_median(m, t, BENCH_SAMPLES);
+            double setup = bench_setup_median(&imgs[i], m, t, BENCH_SAMPLES);
+            printf("%-24s %-8s %12.2f %12.2f\n", imgs[i].name, use_arena ? "arena" : "default", object, setup);
+        }
+    }
+    printf("arena peak %zu bytes, %lu requests from arena, %lu passed to libjpeg\n", mem.arena.peak, mem.n_arena, mem.n_sys);
+    jpegmem_destroy(&mem);
+    free(t);
+    free(out);
+}
+
+static void bench_persistent(bench_img *imgs, int nimg, int iters)
+{
+    unsigned char *out = (unsigned char *)malloc(2048 * 2048 * 4);
+    jpegmem mem;
+    jpegdec dec;
+    if (jpegmem_init(&mem, NULL, JPEGMEM_ARENA_SZ) < 0 || jpegdec_init(&dec, NULL) < 0)
+        return;
+    printf("\n=== Decoder: new decompress object per frame vs persistent jpegdec (%d iterations) ===\n", iters);
+    printf("%-24s %-10s %12s %12s\n", "image", "decoder", "malloc/frm", "us/frame");
+    for (int i = 0; i < nimg; i++)
+    {
+        double setup = 0;
+        unsigned long nmalloc = BENCH_NMALLOC();
+        double start = bench_now();
+        for (int it = 0; it < iters; it++)
+            bench_decode_once(&imgs[i], &mem, out, &setup);
+        double total = bench_now() - start;
+        nmalloc = BENCH_NMALLOC() - nmalloc;
+        printf("%-24s %-10s %12.1f %12.1f\n", imgs[i].name, "per-frame", (double)nmalloc / iters, total / iters);
+
+        jpegdec_decode(&dec, imgs[i].data, imgs[i].len); // output buffer grows on the first frame
+        nmalloc = BENCH_NMALLOC();
+        start = bench_now();
+        for (int it = 0; it < iters; it++)
+            jpegdec_decode(&dec, imgs[i].data, imgs[i].len);
+        total = bench_now() - start;
+        nmalloc = BENCH_NMALLOC() - nmalloc;
+        printf("%-24s %-10s %12.1f %12.1f\n", imgs[i].name, "persistent", (double)nmalloc / iters, total / iters);
+    }
+    jpegdec_destroy(&dec);
+    jpegmem_destroy(&mem);
+    free(out);
+}
+
+static void bench_rows(bench_img *imgs, int nimg, int iters)
+{
+    unsigned char *out = (unsigned char *)malloc(2048 * 2048 * 4);
+    jpegdec dec;
+    jpegmem mem;
+    struct jpeg_decompress_struct row_cinfo, *cinfo = &row_cinfo;
+    struct jpeg_error_mgr jerr;
+    if (jpegdec_init(&dec, NULL) < 0 || jpegmem_init(&mem, NULL, JPEGMEM_ARENA_SZ) < 0)
+        return;
+    // a persistent decompress object driven the way jpegdec did before
+    cinfo->err = jpeg_std_error(&jerr);
+    jpeg_create_decompress(cinfo);
+    jpegmem_attach(&mem, (j_common_ptr)cinfo);
+    printf("\n=== Output: one row + memcpy vs row pointers into the frame (%d iterations) ===\n", iters);
+    printf("%-24s %-10s %12s %12s\n", "image", "output", "reads/frm", "us/frame");
+    for (int i = 0; i < nimg; i++)
+    {
+        unsigned long nreads = 0;
+        double start = bench_now();
+        for (int it = 0; it < iters; it++)
+        {
+            jpeg_mem_src(cinfo, imgs[i].data, imgs[i].len);
+            jpeg_read_header(cinfo, TRUE);
+            cinfo->out_color_space = JCS_EXT_RGBX;
+            jpeg_start_decompress(cinfo);
+            int row_stride = cinfo->output_width * cinfo->output_components;
+            JSAMPARRAY buffer = (*cinfo->mem->alloc_sarray)((j_common_ptr)cinfo, JPOOL_IMAGE, row_stride, 1);
+            while (cinfo->output_scanline < cinfo->output_height)
+            {
+                jpeg_read_scanlines(cinfo, buffer, 1);
+                memcpy(&(out[(cinfo->output_scanline - 1) * row_stride]), buffer[0], row_stride);
+                nreads++;
+            }
+            jpeg_finish_decompress(cinfo);
+        }
+        double total = bench_now() - start;
+        printf("%-24s %-10s %12.1f %12.1f\n", imgs[i].name, "row copy", (double)nreads / iters, total / iters);
+
+        jpegdec_decode(&dec, imgs[i].data, imgs[i].len);
+        nreads = dec.nreads;
+        start = bench_now();
+        for (int it = 0; it < iters; it++)
+            jpegdec_decode(&dec, imgs[i].data, imgs[i].len);
+        total = bench_now() - start;
+        printf("%-24s %-10s %12.1f %12.1f\n", imgs[i].name, "direct", (double)(dec.nreads - nreads) / iters, total / iters);
+    }
+    jpeg_destroy_decompress(cinfo);
+    jpegmem_destroy(&mem);
+    jpegdec_destroy(&dec);
+    free(out);
+}
+
+static void bench_scale(bench_img *imgs, int nimg, int iters)
+{
+    jpegdec dec;
+    if (jpegdec_init(&dec, NULL) < 0)
+        return;
+    printf("\n=== DCT scaling: decode cost at 1/1, 1/2, 1/4 and 1/8 (%d iterations) ===\n", iters);
+    printf("%-24s %-6s %12s %12s %10s\n", "image", "scale", "output", "us/frame", "vs 1/1");
+    for (int i = 0; i < nimg; i++)
+    {
+        double full = 0;
+        for (int denom = 1; denom <= 8; denom <<= 1)
+        {
+            // a view that exactly covers the image at this scale
+            jpegdec_decode(&dec, imgs[i].data, imgs[i].len);
+            dec.view_w = (dec.img_width + denom - 1) / denom;
+            dec.view_h = (dec.img_height + denom - 1) / denom;
+            jpegdec_decode(&dec, imgs[i].data, imgs[i].len);
+            double start = bench_now();
+            for (int it = 0; it < iters; it++)
+                jpegdec_decode(&dec, imgs[i].data, imgs[i].len);
+            double total = (bench_now() - start) / iters;
+            if (denom == 1)
+                full = total;
+            char scale[8], size[16];
+            snprintf(scale, sizeof(scale), "1/%d", dec.scale_denom);
+            snprintf(size, sizeof(size), "%dx%d", dec.width, dec.height);
+            printf("%-24s %-6s %12s %12.1f %9.0f%%\n", imgs[i].name, scale, size, total, total * 100 / full);
+            dec.view_w = dec.view_h = 0;
+        }
+    }
+    jpegdec_destroy(&dec);
+}
+
+static void bench_stream(bench_img *imgs, int nimg, int iters)
+{
+    const int pkg = 512 - 6; // payload of a 512 byte package
+    jpegdec dec;
+    if (jpegdec_init(&dec, NULL) < 0)
+        return;
+    printf("\n=== Incremental decode: work left after the last %d byte package (%d iterations) ===\n", pkg, iters);
+    printf("%-24s %8s %12s %12s %12s\n", "image", "packages", "whole us", "per pkg us", "tail us");
+    for (int i = 0; i < nimg; i++)
+    {
+        int npkg = (imgs[i].len + pkg - 1) / pkg;
+        jpegdec_decode(&dec, imgs[i].data, imgs[i].len);
+        double start = bench_now();
+        for (int it = 0; it < iters; it++)
+            jpegdec_decode(&dec, imgs[i].data, imgs[i].len);
+        double whole = (bench_now() - start) / iters;
+        // packages before the last one are decoded while the next one is on the wire
+        double early = 0, tail = 0;
+        for (int it = 0; it < iters; it++)
+        {
+            jpegdec_stream_begin(&dec, imgs[i].data);
+            start = bench_now();
+            for (int p = 1; p < npkg; p++)
+                jpegdec_stream_feed(&dec, (size_t)p * pkg, 0);
+            double mid = bench_now();
+            if (jpegdec_stream_feed(&dec, imgs[i].len, 1) < 1)
+                fprintf(stderr, "%s: %s did not complete\n", __func__, imgs[i].name);
+            tail += bench_now() - mid;
+            early += mid - start;
+        }
+        printf("%-24s %8d %12.1f %12.1f %12.1f\n", imgs[i].name, npkg, whole, npkg > 1 ? early / iters / (npkg - 1) : 0, tail / iters);
+    }
+    jpegdec_destroy(&dec);
+}
+
+/**
+ * @brief Decode with the floating point IDCT and fancy upsampling, the closest
+ * libjpeg gets to the exact image, as the reference for PSNR.
+ *
+ */
+static void bench_decode_ref(bench_img *img, unsigned char *out)
+{
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, img->data, img->len);
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_EXT_RGBX;
+    cinfo.dct_method = JDCT_FLOAT;
+    jpeg_start_decompress(&cinfo);
+    int row_stride = cinfo.output_width * cinfo.output_components;
+    while (cinfo.output_scanline < cinfo.output_height)
+    {
+        JSAMPROW row = &(out[cinfo.output_scanline * row_stride]);
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+}
+
+/**
+ * @brief PSNR of the color channels of two RGBX images in dB.
+ *
+ */
+static double bench_psnr(const unsigned char *a, const unsigned char *b, int npix)
+{
+    double sse = 0;
+    for (int i = 0; i < npix * 4; i++)
+    {
+        if ((i & 0x3) == 3)
+            continue;
+        int d = a[i] - b[i];
+        sse += d * d;
+    }
+    if (sse == 0)
+        return INFINITY;
+    return 10 * log10(255.0 * 255.0 * npix * 3 / sse);
+}
+
+static void bench_profile(bench_img *imgs, int nimg, int iters)
+{
+    unsigned char *ref = (unsigned char *)malloc(2048 * 2048 * 4);
+    jpegdec dec;
+    if (jpegdec_init(&dec, NULL) < 0)
+        return;
+    printf("\n=== Decode profiles: time and PSNR against a float IDCT decode (%d iterations) ===\n", iters);
+    printf("%-24s %-8s %12s %10s %10s\n", "image", "profile", "us/frame", "vs full", "PSNR dB");
+    for (int i = 0; i < nimg; i++)
+    {
+        bench_decode_ref(&imgs[i], ref);
+        double full = 0, times[JPEGDEC_NPROFILES];
+        for (int p = JPEGDEC_NPROFILES - 1; p >= 0; p--)
+        {
+            dec.profile = (jpegdec_profile)p;
+            jpegdec_decode(&dec, imgs[i].data, imgs[i].len);
+            double start = bench_now();
+            for (int it = 0; it < iters; it++)
+                jpegdec_decode(&dec, imgs[i].data, imgs[i].len);
+            times[p] = (bench_now() - start) / iters;
+            if (p == JPEGDEC_FULL)
+                full = times[p];
+            printf("%-24s %-8s %12.1f %9.0f%% %10.2f\n", imgs[i].name, jpegdec_profile_name(dec.profile), times[p],
+                   times[p] * 100 / full, bench_psnr(ref, dec.out, dec.width * dec.height));
+        }
+    }
+    jpegdec_destroy(&dec);
+    free(ref);
+}
+
+static void bench_format(bench_img *imgs, int nimg, int iters)
+{
+    jpegdec dec;
+    if (jpegdec_init(&dec, NULL) < 0)
+        return;
+    printf("\n=== Output formats produced by libjpeg (%d iterations) ===\n", iters);
+    printf("%-24s %-6s %12s %12s\n", "image", "format", "out bytes", "us/frame");
+    for (int i = 0; i < nimg; i++)
+    {
+        for (int f = 0; f < JPEGDEC_NFORMATS; f++)
+        {
+            dec.format = (jpegdec_format)f;
+            jpegdec_decode(&dec, imgs[i].data, imgs[i].len);
+            double start = bench_now();
+            for (int it = 0; it < iters; it++)
+                jpegdec_decode(&dec, imgs[i].data, imgs[i].len);
+            double total = (bench_now() - start) / iters;
+            size_t bytes = (size_t)dec.stride * dec.height;
+            if (dec.format == JPEGDEC_YCBCR)
+            {
+                bytes = 0;
+                for (int c = 0; c < dec.ncomp; c++)
+                    bytes += (size_t)dec.plane_w[c] * dec.plane_h[c];
+            }
+            printf("%-24s %-6s %12zu %12.1f\n", imgs[i].name, jpegdec_format_name(dec.format), bytes, total);
+        }
+    }
+    jpegdec_destroy(&dec);
+}
+
+static const char *bench_damage_kinds[] = {"intact", "truncated", "bad SOF", "overwrite"};
+#define BENCH_NDAMAGE 4
+
+/**
+ * @brief Copy an image into bad with the given kind of damage. Returns the length
+ * of the damaged image.
+ *
+ */
+static size_t bench_damage(bench_img *img, int kind, unsigned char *bad)
+{
+    size_t len = img->len;
+    memcpy(bad, img->data, len);
+    if (kind == 1)
+        return len / 2;
+    for (size_t p = 2; kind > 1 && p + 8 < len; p++)
+    {
+        if (bad[p] != 0xFF)
+            continue;
+        if (kind == 2 && bad[p + 1] >= 0xC0 && bad[p + 1] <= 0xC2)
+        {
+            bad[p + 5] = bad[p + 6] = 0x0; // zero height
+            bad[p + 4] = 0x3;              // and a bad precision
+            break;
+        }
+        if (kind == 3 && bad[p + 1] == 0xDA) // overwrite the middle of the scan
+        {
+            for (size_t q = p + (len - p) / 2; q < p + (len - p) / 2 + 64 && q < len - 2; q++)
+                bad[q] = 0xFF;
+            break;
+        }
+    }
+    return len;
+}
+
+static void bench_corrupt(bench_img *imgs, int nimg, int iters)
+{
+    jpegdec dec;
+    if (jpegdec_init(&dec, NULL) < 0)
+        return;
+    dec.jerr.pub.output_message = bench_quiet; // warnings on every iteration
+    printf("\n=== Corrupt frames: decode returns instead of exiting (%d iterations) ===\n", iters);
+    printf("%-24s %-10s %8s %8s %12s\n", "image", "damage", "status", "rows", "us/frame");
+    for (int i = 0; i < nimg; i++)
+    {
+        unsigned char *bad = (unsigned char *)malloc(imgs[i].len);
+        for (int k = 0; k < BENCH_NDAMAGE; k++)
+        {
+            size_t len = bench_damage(&imgs[i], k, bad);
+            int status = 0;
+            double start = bench_now();
+            for (int it = 0; it < iters; it++)
+                status = jpegdec_decode(&dec, bad, len);
+            double total = (bench_now() - start) / iters;
+            printf("%-24s %-10s %8s %8d %12.1f\n", imgs[i].name, bench_damage_kinds[k], status > 0 ? "ok" : "error", dec.nrows, total);
+        }
+        free(bad);
+    }
+    printf("%lu images abandoned on errors\n", dec.nerrors);
+    jpegdec_destroy(&dec);
+}
+
+static void bench_check(bench_img *imgs, int nimg, int iters)
+{
+    printf("\n=== Marker check before decode (%d iterations) ===\n", iters * 10);
+    printf("%-24s %-10s %8s %10s %10s %12s\n", "image", "damage", "status", "length", "size", "us/check");
+    for (int i = 0; i < nimg; i++)
+    {
+        unsigned char *bad = (unsigned char *)malloc(imgs[i].len);
+        for (int k = 0; k < BENCH_NDAMAGE; k++)
+        {
+            size_t len = bench_damage(&imgs[i], k, bad);
+            jpegcheck_info chk;
+            int status = 0;
+            double start = bench_now();
+            for (int it = 0; it < iters * 10; it++)
+                status = jpegcheck_scan(bad, len, 0, 0, &chk);
+            double total = (bench_now() - start) / (iters * 10);
+            char size[16];
+            snprintf(size, sizeof(size), "%dx%d", chk.width, chk.height);
+            printf("%-24s %-10s %8s %10zu %10s %12.2f%s%s\n", imgs[i].name, bench_damage_kinds[k],
+                   status > 0 ? "ok" : (status == 0 ? "partial" : "bad"), chk.len, size, total,
+                   chk.error != NULL ? "  " : "", chk.error != NULL ? chk.error : "");
+        }
+        free(bad);
+    }
+}
+
+static void bench_pool_done(jpegpool_job *job, void *user)
+{
+    if (job->status < 0)
+        __atomic_fetch_add((unsigned long *)user, 1, __ATOMIC_RELAXED);
+    jpegpool_release(job);
+}
+
+static void bench_pool(bench_img *imgs, int nimg, int iters)
+{
+    int nbatch = 64;
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t buf_sz = 0;
+    for (int i = 0; i < nimg; i++)
+    {
+        jpegcheck_info chk;
+        jpegcheck_scan(imgs[i].data, imgs[i].len, 0, 0, &chk);
+        if ((size_t)chk.width * chk.height * 4 > buf_sz)
+            buf_sz = (size_t)chk.width * chk.height * 4;
+    }
+    jpegpool_job *jobs = (jpegpool_job *)calloc(nbatch, sizeof(jpegpool_job));
+    printf("\n=== Worker pool: batch of %d stored frames, %ld cores online (%d iterations) ===\n", nbatch, ncpu, iters / 10 + 1);
+    printf("%-8s %12s %12s %10s\n", "workers", "ms/batch", "frames/s", "speedup");
+    double single = 0;
+    for (int nw = 1; nw <= JPEGPOOL_MAX_WORKERS && nw <= 2 * ncpu; nw *= 2)
+    {
+        jpegpool pool;
+        unsigned long nerr = 0;
+        if (jpegpool_init(&pool, nw, nbatch, 2 * nw, buf_sz, NULL) < 0)
+            break;
+        double total = 0;
+        for (int it = 0; it < iters / 10 + 1; it++)
+        {
+            double start = bench_now();
+            for (int j = 0; j < nbatch; j++)
+            {
+                memset(&jobs[j], 0x0, sizeof(jpegpool_job));
+                jobs[j].jpg = imgs[j % nimg].data;
+                jobs[j].len = imgs[j % nimg].len;
+                jobs[j].priority = j % 3;
+                jobs[j].done = bench_pool_done;
+                jobs[j].user = &nerr;
+                jpegpool_submit(&pool, &jobs[j]);
+            }
+            jpegpool_wait(&pool);
+            total += bench_now() - start;
+        }
+        total /= iters / 10 + 1;
+        if (nw == 1)
+            single = total;
+        printf("%-8d %12.2f %12.1f %9.2fx%s\n", nw, total * 1e-3, nbatch * 1e6 / total, single / total, nerr ? "  errors" : "");
+        jpegpool_destroy(&pool);
+    }
+    free(jobs);
+}
+
+static void bench_thumb(bench_img *imgs, int nimg, int iters)
+{
+    jpegdec dec;
+    jpegcoef jc;
+    if (jpegdec_init(&dec, NULL) < 0)
+        return;
+    if (jpegcoef_init(&jc, NULL) < 0)
+    {
+        jpegdec_destroy(&dec);
+        return;
+    }
+    printf("\n=== Thumbnails: DC coefficients only against the 1/8 scaled decode (%d iterations) ===\n", iters);
+    printf("%-24s %10s %12s %12s %12s %10s\n", "image", "thumb", "1/8 us", "read+DC us", "DC only us", "PSNR dB");
+    for (int i = 0; i < nimg; i++)
+    {
+        jpegdec_decode(&dec, imgs[i].data, imgs[i].len);
+        dec.view_w = (dec.img_width + 7) / 8;
+        dec.view_h = (dec.img_height + 7) / 8;
+        double start = bench_now();
+        for (int it = 0; it < iters; it++)
+            jpegdec_decode(&dec, imgs[i].data, imgs[i].len);
+        double scaled = (bench_now() - start) / iters;
+        double read = 0, dc = 0;
+        for (int it = 0; it < iters; it++)
+        {
+            start = bench_now();
+            int ok = jpegcoef_read(&jc, imgs[i].data, imgs[i].len);
+            double mid = bench_now();
+            if (ok > 0)
+                jpegcoef_thumb(&jc, JPEGDEC_RGBX);
+            double end = bench_now();
+            jpegcoef_done(&jc);
+            read += mid - start;
+            dc += end - mid;
+        }
+        read /= iters;
+        dc /= iters;
+        char size[16];
+        snprintf(size, sizeof(size), "%dx%d", jc.width, jc.height);
+        // the difference is in the chroma, which the 1/8 decode takes from 2x2 IDCTs of subsampled blocks
+        double psnr = -1;
+        if (jc.width == dec.width && jc.height == dec.height)
+            psnr = bench_psnr(jc.out, dec.out, jc.width * jc.height);
+        printf("%-24s %10s %12.1f %12.1f %12.1f %10.1f\n", imgs[i].name, size, scaled, read + dc, dc, psnr);
+        dec.view_w = dec.view_h = 0;
+    }
+    jpegcoef_destroy(&jc);
+    jpegdec_destroy(&dec);
+}
+
+static void bench_fit(bench_img *imgs, int nimg, int iters)
+{
+    unsigned char *ref = (unsigned char *)malloc(2048 * 2048 * 4);
+    jpegdec dec;
+    jpegxcode xc;
+    if (jpegdec_init(&dec, NULL) < 0)
+        return;
+    if (jpegxcode_init(&xc, NULL) < 0)
+    {
+        jpegdec_destroy(&dec);
+        return;
+    }
+    int reps = iters / 10 + 1;
+    printf("\n=== Requantization to a byte budget: search cost and PSNR against the original (%d iterations) ===\n", reps);
+    printf("%-24s %8s %10s %10s %8s %6s %8s %10s %10s\n", "image", "budget", "target B", "result B", "scale", "band", "passes", "ms/frame", "PSNR dB");
+    for (int i = 0; i < nimg; i++)
+    {
+        if (jpegdec_decode(&dec, imgs[i].data, imgs[i].len) < 0)
+            continue;
+        memcpy(ref, dec.out, (size_t)dec.width * dec.height * 4);
+        for (int pct = 75; pct >= 25; pct -= 25)
+        {
+            size_t target = imgs[i].len * pct / 100;
+            int ret = 0;
+            double start = bench_now();
+            for (int it = 0; it < reps; it++)
+                ret = jpegxcode_fit(&xc, imgs[i].data, imgs[i].len, target);
+            double total = (bench_now() - start) / reps;
+            double psnr = -1;
+            if (ret >= 0 && jpegdec_decode(&dec, xc.out, xc.out_len) > 0)
+                psnr = bench_psnr(ref, dec.out, dec.width * dec.height);
+            char budget[8];
+            snprintf(budget, sizeof(budget), "%d%%", pct);
+            printf("%-24s %8s %10zu %10zu %7.2fx %6d %8d %10.2f %10.1f%s\n", imgs[i].name, budget, target, xc.out_len, xc.scale * 1e-2, xc.band, xc.npasses, total * 1e-3, psnr, ret > 0 ? "" : "  over");
+        }
+    }
+    jpegxcode_destroy(&xc);
+    jpegdec_destroy(&dec);
+    free(ref);
+}
+
+static void bench_store_done(const jpegstore_rec *rec, void *user)
+{
+    printf("  frame %llu: %zd B received, %zu B JPEG, %zu B stored (%.1f%% saved), %.2f ms\n", rec->seq, rec->rcvd, rec->len, rec->stored,
+           rec->stored ? 100.0 * (rec->rcvd - (ssize_t)rec->stored) / rec->rcvd : 0.0, rec->us * 1e-3);
+    unlink(rec->path);
+}
+
+static void bench_store(bench_img *imgs, int nimg, int iters)
+{
+    const int pad = 256; // left over from package reassembly
+    jpegxcode xc;
+    ucam_frame_pool frames;
+    size_t cap = 0;
+    for (int i = 0; i < nimg; i++)
+        if (imgs[i].len + pad > cap)
+            cap = imgs[i].len + pad;
+    if (ucam_frame_pool_init(&frames, nimg, cap, NULL) < 0)
+        return;
+    if (jpegxcode_init(&xc, NULL) < 0)
+    {
+        ucam_frame_pool_destroy(&frames);
+        return;
+    }
+    printf("\n=== Huffman optimization: lossless rewrite with %d bytes of padding (%d iterations) ===\n", pad, iters);
+    printf("%-24s %10s %10s %10s %8s %10s\n", "image", "rcvd B", "JPEG B", "stored B", "saved", "ms/frame");
+    ucam_frame *fr[BENCH_MAX_IMG];
+    for (int i = 0; i < nimg; i++)
+    {
+        fr[i] = ucam_frame_get(&frames);
+        memcpy(fr[i]->data, imgs[i].data, imgs[i].len);
+        memset(fr[i]->data + imgs[i].len, 0x0, pad);
+        fr[i]->len = imgs[i].len + pad;
+        double start = bench_now();
+        for (int it = 0; it < iters; it++)
+            jpegxcode_optimize(&xc, fr[i]->data, fr[i]->len);
+        double total = (bench_now() - start) / iters;
+        printf("%-24s %10zd %10zu %10zu %7.1f%% %10.2f\n", imgs[i].name, fr[i]->len, xc.in_len, xc.out_len,
+               100.0 * (fr[i]->len - (ssize_t)xc.out_len) / fr[i]->len, total * 1e-3);
+    }
+    jpegxcode_destroy(&xc);
+    // the same frames through the storage thread
+    char dir[] = "/tmp/jpegbench.XXXXXX";
+    jpegstore store;
+    if (mkdtemp(dir) != NULL && jpegstore_init(&store, dir, nimg, bench_store_done, NULL) > 0)
+    {
+        printf("Storage thread:\n");
+        for (int i = 0; i < nimg; i++)
+            jpegstore_put(&store, fr[i]);
+        jpegstore_wait(&store);
+        printf("  %lu frames, %llu B received, %llu B stored\n", store.nstored, store.bytes_in, store.bytes_out);
+        jpegstore_destroy(&store);
+        rmdir(dir);
+    }
+    for (int i = 0; i < nimg; i++)
+        ucam_frame_unref(fr[i]);
+    ucam_frame_pool_destroy(&frames);
+}
+
+static void bench_progressive(bench_img *imgs, int nimg, int iters)
+{
+    unsigned char *ref = (unsigned char *)malloc(2048 * 2048 * 4);
+    unsigned char *base = (unsigned char *)malloc(2 * 1024 * 1024);
+    jpegdec dec;
+    jpegxcode xc;
+    if (jpegdec_init(&dec, NULL) < 0)
+        return;
+    if (jpegxcode_init(&xc, NULL) < 0)
+    {
+        jpegdec_destroy(&dec);
+        return;
+    }
+    dec.jerr.pub.output_message = bench_quiet; // premature end of file on every iteration
+    printf("\n=== Progressive rewrite: cost, size against optimized baseline, PSNR after half the bytes (%d iterations) ===\n", iters);
+    printf("%-24s %10s %10s %9s %10s %10s %10s %10s\n", "image", "base B", "prog B", "overhead", "base ms", "prog ms", "base dB", "prog dB");
+    for (int i = 0; i < nimg; i++)
+    {
+        if (jpegdec_decode(&dec, imgs[i].data, imgs[i].len) < 0)
+            continue;
+        memcpy(ref, dec.out, (size_t)dec.width * dec.height * 4);
+        double ms[2], psnr[2];
+        size_t len[2];
+        for (int p = 0; p < 2; p++)
+        {
+            xc.progressive = p;
+            double start = bench_now();
+            for (int it = 0; it < iters; it++)
+                jpegxcode_optimize(&xc, imgs[i].data, imgs[i].len);
+            ms[p] = (bench_now() - start) / iters * 1e-3;
+            len[p] = xc.out_len;
+            // a downlink pass that ends halfway through the file, cut back to a marker boundary
+            const unsigned char *jpg = xc.out;
+            if (p == 0)
+                jpg = (const unsigned char *)memcpy(base, xc.out, xc.out_len);
+            jpegcheck_info chk;
+            jpegcheck_scan(jpg, len[p] / 2, 0, 0, &chk);
+            psnr[p] = -1;
+            if (jpegdec_decode(&dec, jpg, chk.safe) >= 0 || dec.nrows > 0)
+                psnr[p] = bench_psnr(ref, dec.out, dec.width * dec.height);
+        }
+        printf("%-24s %10zu %10zu %8.1f%% %10.2f %10.2f %10.1f %10.1f\n", imgs[i].name, len[0], len[1], 100.0 * len[1] / len[0] - 100,
+               ms[0], ms[1], psnr[0], psnr[1]);
+    }
+    jpegxcode_destroy(&xc);
+    jpegdec_destroy(&dec);
+    free(base);
+    free(ref);
+}
+
+/**
+ * @brief Shared-table rewrite: size of abbreviated frames against optimized
+ * complete ones, and decode time once the table set is loaded.
+ *
+ */
+static void bench_tables(bench_img *imgs, int nimg, int iters)
+{
+    unsigned char *ref = (unsigned char *)malloc(2048 * 2048 * 4);
+    jpegdec dec;
+    jpegxcode xc;
+    if (jpegdec_init(&dec, NULL) < 0)
+        return;
+    if (jpegxcode_init(&xc, NULL) < 0)
+    {
+        jpegdec_destroy(&dec);
+        return;
+    }
+    printf("\n=== Shared tables: abbreviated frames against optimized complete ones (%d iterations) ===\n", iters);
+    printf("%-24s %10s %10s %8s %8s %10s %10s %10s %6s\n", "image", "full B", "abbrev B", "saved", "tables B", "100 frames", "full ms", "abbrev ms", "same");
+    for (int i = 0; i < nimg; i++)
+    {
+        xc.shared_tables = 0;
+        if (jpegxcode_optimize(&xc, imgs[i].data, imgs[i].len) < 0)
+            continue;
+        size_t full = xc.out_len;
+        double start = bench_now();
+        for (int it = 0; it < iters; it++)
+            jpegdec_decode(&dec, xc.out, xc.out_len);
+        double full_ms = (bench_now() - start) / iters * 1e-3;
+        memcpy(ref, dec.out, (size_t)dec.width * dec.height * 4);
+
+        xc.shared_tables = 1;
+        if (jpegxcode_optimize(&xc, imgs[i].data, imgs[i].len) < 0 || jpegdec_tables(&dec, xc.tables, xc.tables_len) < 0)
+            continue;
+        int same = 1;
+        start = bench_now();
+        for (int it = 0; it < iters; it++)
+            if (jpegdec_decode(&dec, xc.out, xc.out_len) < 0)
+                same = 0;
+        double abbrev_ms = (bench_now() - start) / iters * 1e-3;
+        same = same && memcmp(ref, dec.out, (size_t)dec.width * dec.height * 4) == 0;
+        // a run of frames at one setting shares one table set
+        double run = (100.0 * xc.out_len + xc.tables_len) / (100.0 * full);
+        printf("%-24s %10zu %10zu %7.1f%% %8zu %9.1f%% %10.2f %10.2f %6s\n", imgs[i].name, full, xc.out_len,
+               100.0 - 100.0 * xc.out_len / full, xc.tables_len, 100 - 100 * run, full_ms, abbrev_ms, same ? "yes" : "NO");
+    }
+    jpegxcode_destroy(&xc);
+    jpegdec_destroy(&dec);
+    free(ref);
+}
+
+/**
+ * @brief Encode an RGB image after a horizontal box blur over len pixels, the
+ * smear of a camera panning during the exposure.
+ *
+ */
+static void bench_smear(const unsigned char *rgb, int width, int height, int len, unsigned char **jpg, unsigned long *jpg_len)
+{
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    unsigned char *row = (unsigned char *)malloc(width * 3);
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    *jpg = NULL;
+    *jpg_len = 0;
+    jpeg_mem_dest(&cinfo, jpg, jpg_len);
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, 75, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < cinfo.image_height)
+    {
+        const unsigned char *in = &(rgb[(size_t)cinfo.next_scanline * width * 3]);
+        for (int x = 0; x < width; x++)
+            for (int c = 0; c < 3; c++)
+            {
+                int sum = 0;
+                for (int k = 0; k < len; k++)
+                    sum += in[3 * (x + k < width ? x + k : width - 1) + c];
+                row[3 * x + c] = sum / len;
+            }
+        JSAMPROW rows[1] = {row};
+        jpeg_write_scanlines(&cinfo, rows, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    free(row);
+}
+
+/**
+ * @brief Sharpness score of every frame smeared over 1 (sharp) to 16 pixels, and
+ * the cost of scoring.
+ *
+ */
+static void bench_sharp(bench_img *imgs, int nimg, int iters)
+{
+    static const int smear[] = {1, 2, 4, 8, 16};
+    const int nsmear = sizeof(smear) / sizeof(smear[0]);
+    jpegdec dec;
+    jpegcoef jc;
+    if (jpegdec_init(&dec, NULL) < 0)
+        return;
+    if (jpegcoef_init(&jc, NULL) < 0)
+    {
+        jpegdec_destroy(&dec);
+        return;
+    }
+    dec.format = JPEGDEC_RGB;
+    printf("\n=== Sharpness from AC energy, frames smeared horizontally over N pixels (%d iterations) ===\n", iters);
+    printf("%-24s", "image");
+    for (int s = 0; s < nsmear; s++)
+        printf(" %7s%-2d", "N = ", smear[s]);
+    printf(" %10s %10s\n", "read us", "score us");
+    for (int i = 0; i < nimg; i++)
+    {
+        if (jpegdec_decode(&dec, imgs[i].data, imgs[i].len) < 0)
+            continue;
+        printf("%-24s", imgs[i].name);
+        double read = 0, score = 0;
+        for (int s = 0; s < nsmear; s++)
+        {
+            unsigned char *jpg;
+            unsigned long len;
+            bench_smear(dec.out, dec.width, dec.height, smear[s], &jpg, &len);
+            double sharpness = -1;
+            for (int it = 0; it < (s == 0 ? iters : 1); it++)
+            {
+                double start = bench_now();
+                int ok = jpegcoef_read(&jc, jpg, len);
+                double mid = bench_now();
+                if (ok > 0)
+                    jpegcoef_sharpness(&jc, &sharpness);
+                double end = bench_now();
+                jpegcoef_done(&jc);
+                read += mid - start;
+                score += end - mid;
+            }
+            printf(" %9.3f", sharpness);
+            free(jpg);
+        }
+        printf(" %10.1f %10.1f\n", read / (iters + nsmear - 1), score / (iters + nsmear - 1));
+    }
+    jpegcoef_destroy(&jc);
+    jpegdec_destroy(&dec);
+}
+
+/**
+ * @brief Luminance statistics from DC coefficients against block means of the
+ * decoded pixels, and what each costs.
+ *
+ */
+static void bench_luma(bench_img *imgs, int nimg, int iters)
+{
+    jpegdec dec;
+    jpegcoef jc;
+    if (jpegdec_init(&dec, NULL) < 0)
+        return;
+    if (jpegcoef_init(&jc, NULL) < 0)
+    {
+        jpegdec_destroy(&dec);
+        return;
+    }
+    dec.format = JPEGDEC_GRAY;
+    printf("\n=== Luminance histogram: DC coefficients against decoded block means (%d iterations) ===\n", iters);
+    printf("%-24s %10s %10s %10s %8s %8s %9s %9s %9s\n", "image", "decode us", "read us", "hist us", "mean", "pix mean", "max |d|", "clipped", "crushed");
+    for (int i = 0; i < nimg; i++)
+    {
+        double start = bench_now();
+        for (int it = 0; it < iters; it++)
+            jpegdec_decode(&dec, imgs[i].data, imgs[i].len);
+        double decode = (bench_now() - start) / iters;
+        ucam_luma luma;
+        double read = 0, hist = 0;
+        for (int it = 0; it < iters; it++)
+        {
+            start = bench_now();
+            int ok = jpegcoef_read(&jc, imgs[i].data, imgs[i].len);
+            double mid = bench_now();
+            if (ok > 0)
+                jpegcoef_luma(&jc, &luma);
+            double end = bench_now();
+            jpegcoef_done(&jc);
+            read += mid - start;
+            hist += end - mid;
+        }
+        // the same statistics from the pixels, over whole blocks
+        int bw = dec.width / DCTSIZE, bh = dec.height / DCTSIZE;
+        double pix_mean = 0, max_diff = 0;
+        unsigned int pix_hist[UCAM_LUMA_NBINS] = {0};
+        for (int by = 0; by < bh; by++)
+            for (int bx = 0; bx < bw; bx++)
+            {
+                int sum = 0;
+                for (int y = 0; y < DCTSIZE; y++)
+                    for (int x = 0; x < DCTSIZE; x++)
+                        sum += dec.out[(size_t)(by * DCTSIZE + y) * dec.stride + bx * DCTSIZE + x];
+                pix_mean += sum / (double)DCTSIZE2;
+                pix_hist[(sum / DCTSIZE2) * UCAM_LUMA_NBINS / 256]++;
+            }
+        pix_mean /= bw * bh;
+        // largest difference of the cumulative histograms, as a fraction of the blocks
+        long cum = 0;
+        for (int b = 0; b < UCAM_LUMA_NBINS; b++)
+        {
+            cum += (long)luma.hist[b] - pix_hist[b];
+            if (fabs((double)cum / (bw * bh)) > max_diff)
+                max_diff = fabs((double)cum / (bw * bh));
+        }
+        printf("%-24s %10.1f %10.1f %10.1f %8.1f %8.1f %8.1f%% %8.1f%% %8.1f%%\n", imgs[i].name, decode, read / iters, hist / iters,
+               luma.mean, pix_mean, max_diff * 100, luma.clipped * 100, luma.crushed * 100);
+    }
+    jpegcoef_destroy(&jc);
+    jpegdec_destroy(&dec);
+}
+
+/**
+ * @brief Encode a grayscale image.
+ *
+ */
+static void bench_encode_gray(const unsigned char *pix, int width, int height, unsigned char **jpg, unsigned long *jpg_len)
+{
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    *jpg = NULL;
+    *jpg_len = 0;
+    jpeg_mem_dest(&cinfo, jpg, jpg_len);
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 1;
+    cinfo.in_color_space = JCS_GRAYSCALE;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, 75, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < cinfo.image_height)
+    {
+        JSAMPROW rows[1] = {(JSAMPROW) & (pix[(size_t)cinfo.next_scanline * width])};
+        jpeg_write_scanlines(&cinfo, rows, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+}
+
+/**
+ * @brief Auto-exposure against a simulated camera: the first frame is the scene,
+ * brightened or darkened by a number of stops, and every exposure level moves
+ * the sensor by a step that need not be the one the controller assumes.
+ * Contrast scales around mid-gray by 30% per setting. Each frame is encoded,
+ * measured with jpegcoef_luma and fed back.
+ *
+ */
+static void bench_ae(bench_img *imgs, int nimg, int iters)
+{
+    static const float scene_ev[] = {-3, -1.5, 1.5, 3};
+    static const float step_ev[] = {0.35f, 0.5f, 0.7f};
+    const int nframes = 12;
+    jpegdec dec;
+    jpegcoef jc;
+    if (nimg < 1 || jpegdec_init(&dec, NULL) < 0)
+        return;
+    if (jpegcoef_init(&jc, NULL) < 0)
+    {
+        jpegdec_destroy(&dec);
+        return;
+    }
+    dec.format = JPEGDEC_GRAY;
+    if (jpegdec_decode(&dec, imgs[0].data, imgs[0].len) < 0)
+    {
+        jpegcoef_destroy(&jc);
+        jpegdec_destroy(&dec);
+        return;
+    }
+    int npix = dec.width * dec.height;
+    unsigned char *pix = (unsigned char *)malloc(npix);
+    printf("\n=== Auto-exposure on %s, simulated sensor (%d frames) ===\n", imgs[0].name, nframes);
+    printf("%8s %8s %8s %10s %10s %10s %10s %9s\n", "scene", "step", "settled", "changes", "reversals", "C/B/E", "mean", "clipped");
+    for (unsigned s = 0; s < sizeof(scene_ev) / sizeof(scene_ev[0]); s++)
+        for (unsigned t = 0; t < sizeof(step_ev) / sizeof(step_ev[0]); t++)
+        {
+            ucam_ae ae;
+            ucam_ae_init(&ae, 2, 2, 2);
+            ucam_frame frame;
+            memset(&frame, 0x0, sizeof(ucam_frame));
+            int settled = 0, reversals = 0, last_dir = 0;
+            for (int f = 0; f < nframes; f++)
+            {
+                frame.contrast = ae.contrast;
+                frame.brightness = ae.brightness;
+                frame.exposure = ae.exposure;
+                float gain = exp2f(scene_ev[s] + (frame.brightness + frame.exposure - UCAM_AE_NOMINAL) * step_ev[t]);
+                float contrast = 1 + 0.3f * (frame.contrast - 2);
+                for (int i = 0; i < npix; i++)
+                {
+                    float v = 128 + (dec.out[i] * gain - 128) * contrast;
+                    pix[i] = v < 0 ? 0 : (v > 255 ? 255 : (unsigned char)v);
+                }
+                unsigned char *jpg;
+                unsigned long len;
+                bench_encode_gray(pix, dec.width, dec.height, &jpg, &len);
+                if (jpegcoef_read(&jc, jpg, len) > 0)
+                    jpegcoef_luma(&jc, &(frame.luma));
+                jpegcoef_done(&jc);
+                free(jpg);
+                int level = ae.brightness + ae.exposure;
+                if (ucam_ae_update(&ae, &frame) > 0)
+                {
+                    settled = f + 1; // the first frame taken with the settings that stay
+                    int dir = ae.brightness + ae.exposure - level;
+                    if (dir != 0 && last_dir != 0 && (dir > 0) != (last_dir > 0))
+                        reversals++;
+                    if (dir != 0)
+                        last_dir = dir;
+                }
+            }
+            char cbe[16];
+            snprintf(cbe, sizeof(cbe), "%d/%d/%d", ae.contrast, ae.brightness, ae.exposure);
+            printf("%+8.1f %8.2f %8d %10lu %10d %10s %10.0f %8.1f%%\n", scene_ev[s], step_ev[t], settled, ae.nchanges, reversals, cbe,
+                   frame.luma.mean, frame.luma.clipped * 100);
+        }
+    free(pix);
+    jpegcoef_destroy(&jc);
+    jpegdec_destroy(&dec);
+}
+
+/**
+ * @brief Flicker detection against simulated mains lighting: rolling-shutter
+ * bands at a random phase in every frame, which go away once the camera has
+ * the matching light setting, which it starts without. Frames are measured on
+ * their DC thumbnails.
+ *
+ */
+static void bench_flicker(bench_img *imgs, int nimg, int iters)
+{
+    static const int mains[] = {0, 50, 60};
+    static const float depth[] = {0.03f, 0.1f};
+    const int nframes = 10;
+    jpegdec dec;
+    jpegcoef jc;
+    if (jpegdec_init(&dec, NULL) < 0)
+        return;
+    if (jpegcoef_init(&jc, NULL) < 0)
+    {
+        jpegdec_destroy(&dec);
+        return;
+    }
+    dec.format = JPEGDEC_GRAY;
+    unsigned char *pix = (unsigned char *)malloc(2048 * 2048);
+    unsigned int seed = 1;
+    printf("\n=== Flicker detection on DC thumbnails, starting at the wrong setting (%d frames) ===\n", nframes);
+    printf("%-24s %6s %6s %8s %8s %8s %10s %10s\n", "image", "mains", "depth", "light", "changed", "changes", "thumb us", "detect us");
+    for (int i = 0; i < nimg; i++)
+    {
+        if (jpegdec_decode(&dec, imgs[i].data, imgs[i].len) < 0 || dec.height > 480)
+            continue;
+        float lines_per_row = 480.0f / dec.height; // scaled from the VGA sensor
+        for (unsigned m = 0; m < sizeof(mains) / sizeof(mains[0]); m++)
+            for (unsigned d = 0; d < (mains[m] ? sizeof(depth) / sizeof(depth[0]) : 1); d++)
+            {
+                ucam_flicker fl;
+                ucam_flicker_init(&fl, mains[m] == 50 ? 0x1 : 0x0);
+                int changed = -1;
+                double thumb = 0, detect = 0;
+                for (int f = 0; f < nframes; f++)
+                {
+                    // the matching setting makes the exposure a whole number of flicker periods
+                    float amp = mains[m] && (fl.light ? 60 : 50) != mains[m] ? depth[d] : 0;
+                    float period = mains[m] ? 1e6f / (2 * mains[m]) / UCAM_FLICKER_LINE_US : 1;
+                    seed = seed * 1103515245 + 12345;
+                    float phase = (seed >> 8) * (float)(2 * M_PI / (1 << 24));
+                    for (int y = 0; y < dec.height; y++)
+                    {
+                        float g = 1 + amp * sinf(2 * (float)M_PI * y * lines_per_row / period + phase);
+                        for (int x = 0; x < dec.width; x++)
+                        {
+                            float v = dec.out[(size_t)y * dec.stride + x] * g;
+                            pix[(size_t)y * dec.width + x] = v > 255 ? 255 : (unsigned char)v;
+                        }
+                    }
+                    unsigned char *jpg;
+                    unsigned long len;
+                    bench_encode_gray(pix, dec.width, dec.height, &jpg, &len);
+                    double start = bench_now();
+                    if (jpegcoef_read(&jc, jpg, len) > 0 && jpegcoef_thumb(&jc, JPEGDEC_GRAY) > 0)
+                    {
+                        double mid = bench_now();
+                        int ret = ucam_flicker_update(&fl, jc.out, jc.width, jc.height, jc.stride, lines_per_row * DCTSIZE, fl.light);
+                        detect += bench_now() - mid;
+                        thumb += mid - start;
+                        if (ret > 0)
+                            changed = f;
+                    }
+                    jpegcoef_done(&jc);
+                    free(jpg);
+                }
+                char light[8], when[8];
+                snprintf(light, sizeof(light), "%d Hz", fl.light ? 60 : 50);
+                snprintf(when, sizeof(when), changed < 0 ? "-" : "%d", changed);
+                printf("%-24s %6d %5.0f%% %8s %8s %8lu %10.1f %10.1f\n", imgs[i].name, mains[m], mains[m] ? depth[d] * 100 : 0,
+                       light, when, fl.nchanges, thumb / nframes, detect / nframes);
+            }
+    }
+    free(pix);
+    jpegcoef_destroy(&jc);
+    jpegdec_destroy(&dec);
+}
+
+static void bench_advance(struct timespec *ts, double us)
+{
+    long long ns = ts->tv_nsec + (long long)(us * 1e3);
+    ts->tv_sec += ns / 1000000000LL;
+    ts->tv_nsec = ns % 1000000000LL;
+}
+
+/**
+ * @brief Watch mode on a simulated 80x60 GRAY8 stream with sensor noise and a
+ * slow brightness drift. An object appears, moves and leaves; every trigger
+ * costs a 640x480 JPEG. Frame times are what the bytes take on the wire at
+ * 115200 baud, plus 80 ms per command, as in the driver.
+ *
+ */
+static void bench_watch(bench_img *imgs, int nimg, int iters)
+{
+    const int width = 80, height = 60, npix = width * height, nframes = 300;
+    const int events[] = {60, 140, 220}; // appears, moves, leaves
+    jpegdec dec;
+    if (nimg < 3 || jpegdec_init(&dec, NULL) < 0)
+        return;
+    dec.format = JPEGDEC_GRAY;
+    dec.view_w = width;
+    dec.view_h = height;
+    if (jpegdec_decode(&dec, imgs[2].data, imgs[2].len) < 0 || dec.width < width || dec.height < height)
+    {
+        jpegdec_destroy(&dec);
+        return;
+    }
+    ucam_frame raw, full;
+    memset(&raw, 0x0, sizeof(ucam_frame));
+    memset(&full, 0x0, sizeof(ucam_frame));
+    raw.data = (unsigned char *)malloc(npix);
+    raw.img_fmt = GRAY8;
+    raw.raw_res = UCAM_RAW_W80H60;
+    raw.len = npix;
+    full.len = imgs[2].len; // the 640x480 frame
+    double raw_us = 80e3 + npix * 10 / 115200.0 * 1e6;
+    double full_us = 3 * 80e3 + (full.len + (full.len + 505) / 506 * 12) * 10 / 115200.0 * 1e6; // INIT twice, GET_PIC
+    ucam_watch w;
+    ucam_watch_init(&w);
+    struct timespec now = {0, 0};
+    unsigned int seed = 7;
+    int triggers[16], ntrig = 0, false_trig = 0;
+    for (int f = 0; f < nframes; f++)
+    {
+        int ox = f < events[1] ? 10 : 50, oy = 20;
+        int object = f >= events[0] && f < events[2];
+        float drift = 1 + 0.1f * f / nframes; // auto-exposure creeping
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++)
+            {
+                seed = seed * 1103515245 + 12345;
+                int noise = (int)((seed >> 16) & 0xf) - 8; // +-8 gray levels
+                int v = dec.out[(size_t)y * dec.stride + x] * drift + noise;
+                if (object && x >= ox && x < ox + 20 && y >= oy && y < oy + 15)
+                    v = 230 + noise;
+                raw.data[y * width + x] = v < 0 ? 0 : (v > 255 ? 255 : v);
+            }
+        raw.t_snap = now;
+        bench_advance(&now, raw_us);
+        raw.t_last = now;
+        if (ucam_watch_update(&w, &raw) > 0)
+        {
+            int near = 0;
+            for (int e = 0; e < 3; e++)
+                near |= f >= events[e] && f < events[e] + 3;
+            false_trig += !near;
+            if (ntrig < 16)
+                triggers[ntrig++] = f;
+            full.t_snap = now;
+            bench_advance(&now, full_us);
+            full.t_last = now;
+            ucam_watch_full(&w, &raw, &full);
+        }
+    }
+    printf("\n=== Watch mode: 80x60 GRAY8 change detection, %d frames, events at %d, %d, %d ===\n", nframes, events[0], events[1], events[2]);
+    printf("triggered at frames");
+    for (int i = 0; i < ntrig; i++)
+        printf(" %d", triggers[i]);
+    printf(" (%d false)\n", false_trig);
+    printf("compare %.2f us per frame, duty cycle %.1f%% of time, %.1f%% of bytes\n", w.compare_us, ucam_watch_duty(&w) * 100,
+           100.0 * w.full_bytes / (w.full_bytes + w.watch_bytes));
+    printf("change to full frame %.0f ms mean, %.0f ms max; continuous 640x480 capture would take %.0f ms per frame\n",
+           w.latency_us * 1e-3, w.latency_max_us * 1e-3, full_us * 1e-3);
+    free(raw.data);
+    jpegdec_destroy(&dec);
+}
+
+/**
+ * @brief Bursts of simulated low light GRAY8 frames at every RAW size: a dim
+ * scene with sensor noise, and hand shake moving the frame up to 4 pixels. The
+ * stack is compared to the noiseless scene, against a single frame. The last
+ * burst has an object passing through one frame, which should be dropped.
+ *
+ */
+static void bench_stack(bench_img *imgs, int nimg, int iters)
+{
+    const unsigned char res[] = {UCAM_RAW_W80H60, UCAM_RAW_W128H96, UCAM_RAW_W128H128, UCAM_RAW_W160H120};
+    const int nburst[] = {4, 8, 16};
+    const int jitter = 4;
+    if (nimg < 3)
+        return;
+    // a real scene if there is one, the synthetic checkerboard cancels in the row and column sums
+    bench_img *scene = nimg > 3 ? &imgs[3] : &imgs[2];
+    ucam_stack *st = (ucam_stack *)malloc(sizeof(ucam_stack));
+    unsigned char *truth = (unsigned char *)malloc(UCAM_STACK_MAX_NPIX);
+    ucam_frame raw;
+    memset(&raw, 0x0, sizeof(ucam_frame));
+    raw.data = (unsigned char *)malloc(UCAM_STACK_MAX_NPIX);
+    raw.img_fmt = GRAY8;
+    ucam_stack_init(st);
+    printf("\n=== Burst stacking: GRAY8 frames of %s, noise sigma 12, shake up to %d px ===\n", scene->name, jitter);
+    printf("%-8s %3s %10s %10s %8s %12s %12s %10s %10s\n", "size", "N", "single dB", "stack dB", "misreg", "register us", "accum us", "finish us", "link ms");
+    for (int r = 0; r < (int)(sizeof(res) / sizeof(res[0])); r++)
+    {
+        int width, height;
+        ucam_frame_raw_dims(res[r], &width, &height);
+        int npix = width * height;
+        jpegdec dec;
+        if (jpegdec_init(&dec, NULL) < 0)
+            break;
+        dec.format = JPEGDEC_GRAY;
+        dec.view_w = width + 2 * jitter;
+        dec.view_h = height + 2 * jitter;
+        if (jpegdec_decode(&dec, scene->data, scene->len) < 0 || dec.width < dec.view_w || dec.height < dec.view_h)
+        {
+            jpegdec_destroy(&dec);
+            continue;
+        }
+        raw.raw_res = res[r];
+        raw.len = npix;
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++)
+                truth[y * width + x] = 20 + 0.3f * dec.out[(size_t)(y + jitter) * dec.stride + x + jitter] + 0.5f;
+        for (int b = 0; b < (int)(sizeof(nburst) / sizeof(nburst[0])); b++)
+        {
+            int passing = r == 3 && b == 2 ? nburst[b] / 2 : -1;
+            unsigned int seed = 11;
+            int sx = 0, sy = 0, sx0 = 0, sy0 = 0, misreg = 0, dropped = -1;
+            double single = 0;
+            ucam_stack_reset(st);
+            for (int f = 0; f < nburst[b]; f++)
+            {
+                seed = seed * 1103515245 + 12345;
+                sx += (int)((seed >> 16) % 3) - 1;
+                seed = seed * 1103515245 + 12345;
+                sy += (int)((seed >> 16) % 3) - 1;
+                sx = sx < -jitter ? -jitter : (sx > jitter ? jitter : sx);
+                sy = sy < -jitter ? -jitter : (sy > jitter ? jitter : sy);
+                for (int y = 0; y < height; y++)
+                    for (int x = 0; x < width; x++)
+                    {
+                        int noise = 0;
+                        for (int k = 0; k < 4; k++) // sum of uniforms, sigma 12
+                        {
+                            seed = seed * 1103515245 + 12345;
+                            noise += (int)((seed >> 16) % 21) - 10;
+                        }
+                        float v = 20 + 0.3f * dec.out[(size_t)(y + jitter + sy) * dec.stride + x + jitter + sx] + noise;
+                        if (f == passing && x >= width / 4 && x < width * 3 / 4 && y >= height / 4 && y < height * 3 / 4)
+                            v = 200 + noise;
+                        raw.data[y * width + x] = v < 0 ? 0 : (v > 255 ? 255 : v + 0.5f);
+                    }
+                if (f == 0)
+                {
+                    sx0 = sx;
+                    sy0 = sy;
+                    // the truth is the scene as the reference frame saw it
+                    for (int y = 0; y < height; y++)
+                        for (int x = 0; x < width; x++)
+                            truth[y * width + x] = 20 + 0.3f * dec.out[(size_t)(y + jitter + sy) * dec.stride + x + jitter + sx] + 0.5f;
+                }
+                int ret = ucam_stack_add(st, &raw);
+                if (ret == 0)
+                    dropped = f;
+                else if (ret > 0 && f > 0)
+                    misreg += st->dx != sx0 - sx || st->dy != sy0 - sy;
+                if (f == 0)
+                {
+                    double sse = 0;
+                    for (int i = 0; i < npix; i++)
+                        sse += (double)(raw.data[i] - truth[i]) * (raw.data[i] - truth[i]);
+                    single = 10 * log10(255.0 * 255.0 * npix / sse);
+                }
+            }
+            ucam_stack_finish(st);
+            double sse = 0;
+            for (int i = 0; i < npix; i++)
+                sse += (double)(st->out[i] - truth[i]) * (st->out[i] - truth[i]);
+            char size[16];
+            snprintf(size, sizeof(size), "%dx%d", width, height);
+            printf("%-8s %3d %10.2f %10.2f %8d %12.1f %12.1f %10.1f %10.0f\n", size, nburst[b], single, 10 * log10(255.0 * 255.0 * npix / sse), misreg,
+                   st->register_us, st->accumulate_us, st->finish_us, (80e3 + npix * 10 / 115200.0 * 1e6) * 1e-3);
+            if (passing >= 0)
+                printf("object passing through frame %d: %s (dropped %d of %d)\n", passing, dropped == passing ? "dropped" : "NOT dropped", st->nrejected, nburst[b]);
+        }
+        jpegdec_destroy(&dec);
+    }
+    free(raw.data);
+    free(truth);
+    free(st);
+}
+
+int main(int argc, char *argv[])
+{
+    bench_img imgs[BENCH_MAX_IMG];
+    int nimg = 0;
+    int iters = 100;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            iters = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n iterations] [image.jpg ...]\n", argv[0]);
+            return -1;
+        }
+    }
+    if (iters < 1)
+        iters = 1;
+    // frames the size the camera produces
+    bench_img_synth(&imgs[nimg++], 160, 128, 75);
+    bench_img_synth(&imgs[nimg++], 320, 240, 75);
+    bench_img_synth(&imgs[nimg++], 640, 480, 75);
+    if (optind >= argc) // reference still
+    {
+        if (bench_img_load(&imgs[nimg], "test.jpeg") > 0)
+            nimg++;
+    }
+    for (int i = optind; i < argc && nimg < BENCH_MAX_IMG; i++)
+    {
+        if (bench_img_load(&imgs[nimg], argv[i]) > 0)
+            nimg++;
+    }
+    printf("Corpus:\n");
+    for (int i = 0; i < nimg; i++)
+        printf("  %-24s %8lu bytes\n", imgs[i].name, imgs[i].len);
+
+    bench_memmgr(imgs, nimg, iters);
+    bench_persistent(imgs, nimg, iters);
+    bench_rows(imgs, nimg, iters);
+    bench_scale(imgs, nimg, iters);
+    bench_stream(imgs, nimg, iters);
+    bench_profile(imgs, nimg, iters);
+    bench_format(imgs, nimg, iters);
+    bench_corrupt(imgs, nimg, iters);
+    bench_check(imgs, nimg, iters);
+    bench_pool(imgs, nimg, iters);
+    bench_thumb(imgs, nimg, iters);
+    bench_fit(imgs, nimg, iters);
+    bench_store(imgs, nimg, iters);
+    bench_progressive(imgs, nimg, iters);
+    bench_tables(imgs, nimg, iters);
+    bench_sharp(imgs, nimg, iters);
+    bench_luma(imgs, nimg, iters);
+    bench_ae(imgs, nimg, iters);
+    bench_flicker(imgs, nimg, iters);
+    bench_watch(imgs, nimg, iters);
+    bench_stack(imgs, nimg, iters);
+
+    for (int i = 0; i < nimg; i++)
+        free(imgs[i].data);
+    return 0;
+}
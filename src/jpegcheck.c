@@ -0,0 +1,120 @@
+/**
+ * @file jpegcheck.c
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Marker-level JPEG validation that runs before a frame is decoded.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <jpegcheck.h>
+#include <string.h>
+
+#define JPEGCHECK_ERR(msg) \
+    {                      \
+        info->error = msg; \
+        return -1;         \
+    }
+
+/**
+ * @brief Skip the entropy-coded data that starts at pos. Stuffed 0xFF00 bytes and
+ * restart markers belong to the scan; any other marker ends it.
+ *
+ * @return size_t Offset of the marker that ends the scan, len if the data ends first
+ */
+static size_t jpegcheck_skip_scan(const unsigned char *jpg, size_t len, size_t pos)
+{
+    while (pos < len)
+    {
+        const unsigned char *ff = (const unsigned char *)memchr(&(jpg[pos]), 0xFF, len - pos);
+        if (ff == NULL || (size_t)(ff - jpg) + 1 >= len)
+            return len;
+        pos = ff - jpg;
+        unsigned char m = jpg[pos + 1];
+        if (m == 0x00 || (m >= 0xD0 && m <= 0xD7))
+            pos += 2;
+        else if (m == 0xFF)
+            pos++; // fill byte before a marker
+        else
+            return pos;
+    }
+    return len;
+}
+
+int jpegcheck_scan(const unsigned char *jpg, size_t len, int width, int height, jpegcheck_info *info)
+{
+    memset(info, 0x0, sizeof(jpegcheck_info));
+    if (len < 2)
+        return 0;
+    if (jpg[0] != 0xFF || jpg[1] != 0xD8)
+        JPEGCHECK_ERR("no SOI");
+    info->found |= JPEGCHECK_SOI;
+    size_t pos = 2;
+    while (pos + 2 <= len)
+    {
+        info->safe = pos; // a marker segment starts here
+        if (jpg[pos] != 0xFF)
+            JPEGCHECK_ERR("data between marker segments");
+        unsigned char m = jpg[pos + 1];
+        if (m == 0xFF) // fill byte
+        {
+            pos++;
+            continue;
+        }
+        if (m == 0xD9)
+        {
+            if (!(info->found & JPEGCHECK_SOS))
+                JPEGCHECK_ERR("EOI before any scan");
+            info->found |= JPEGCHECK_EOI;
+            info->len = info->safe = pos + 2;
+            return 1;
+        }
+        if (m == 0xD8 || m == 0x00)
+            JPEGCHECK_ERR("unexpected marker");
+        if (m == 0x01 || (m >= 0xD0 && m <= 0xD7)) // markers without a segment
+        {
+            pos += 2;
+            continue;
+        }
+        if (pos + 4 > len)
+            return 0;
+        size_t seglen = (jpg[pos + 2] << 8) | jpg[pos + 3];
+        if (seglen < 2)
+            JPEGCHECK_ERR("marker segment too short");
+        if (pos + 2 + seglen > len)
+            return 0;
+        if (m >= 0xC0 && m <= 0xCF && m != 0xC4 && m != 0xC8 && m != 0xCC) // SOFn
+        {
+            if (info->found & JPEGCHECK_SOF)
+                JPEGCHECK_ERR("second SOF");
+            if (seglen < 8)
+                JPEGCHECK_ERR("SOF too short");
+            info->height = (jpg[pos + 5] << 8) | jpg[pos + 6];
+            info->width = (jpg[pos + 7] << 8) | jpg[pos + 8];
+            info->ncomp = jpg[pos + 9];
+            info->progressive = m == 0xC2;
+            if (jpg[pos + 4] != 8 && jpg[pos + 4] != 12)
+                JPEGCHECK_ERR("bad sample precision");
+            if (info->width == 0 || info->height == 0)
+                JPEGCHECK_ERR("zero image size");
+            if (info->ncomp < 1 || info->ncomp > 4 || seglen != 8 + 3 * (size_t)info->ncomp)
+                JPEGCHECK_ERR("bad component count");
+            if (width > 0 && height > 0 && (info->width != width || info->height != height))
+                JPEGCHECK_ERR("image size does not match the configured resolution");
+            info->found |= JPEGCHECK_SOF;
+        }
+        pos += 2 + seglen;
+        if (m == 0xDA) // SOS, the entropy-coded data follows the header
+        {
+            if (!(info->found & JPEGCHECK_SOF))
+                JPEGCHECK_ERR("SOS before SOF");
+            info->found |= JPEGCHECK_SOS;
+            pos = jpegcheck_skip_scan(jpg, len, pos);
+            info->safe = pos; // entropy-coded data can be cut anywhere
+        }
+    }
+    if (pos == len)
+        info->safe = len;
+    return 0;
+}
@@ -0,0 +1,272 @@
+/**
+ * @file jpegcoef.c
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Work on the quantized DCT coefficients of a JPEG without decoding pixels.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <jpegcoef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <setjmp.h>
+
+/**
+ * @brief Report the libjpeg error that was raised, count it and drop the image.
+ *
+ */
+static void jpegcoef_error(jpegcoef *jc)
+{
+    jpegdec_err_caught(&(jc->jerr), (j_common_ptr) & (jc->cinfo), &(jc->mem));
+    jc->nerrors++;
+    jpeg_abort_decompress(&(jc->cinfo));
+    jc->coefs = NULL;
+}
+
+int jpegcoef_init(jpegcoef *jc, ucam_arena *arena)
+{
+    memset(jc, 0x0, sizeof(jpegcoef));
+    jpegdec_err_init(&(jc->jerr), (j_common_ptr) & (jc->cinfo));
+    if (setjmp(jc->jerr.env))
+    {
+        jpegcoef_error(jc);
+        jpeg_destroy_decompress(&(jc->cinfo));
+        return -1;
+    }
+    jpeg_create_decompress(&(jc->cinfo));
+    if (jpegmem_init(&(jc->mem), arena, JPEGCOEF_ARENA_SZ) > 0)
+        jpegmem_attach(&(jc->mem), (j_common_ptr) & (jc->cinfo));
+    else
+        fprintf(stderr, "%s: Using libjpeg's memory manager\n", __func__);
+    return 1;
+}
+
+int jpegcoef_read(jpegcoef *jc, const unsigned char *jpg, size_t len)
+{
+    struct jpeg_decompress_struct *cinfo = &(jc->cinfo);
+    if (jc->coefs != NULL)
+        jpegcoef_done(jc);
+    if (setjmp(jc->jerr.env))
+    {
+        jpegcoef_error(jc);
+        return -1;
+    }
+    jpeg_mem_src(cinfo, jpg, len);
+    if (jpeg_read_header(cinfo, TRUE) != JPEG_HEADER_OK)
+    {
+        jpeg_abort_decompress(cinfo);
+        return -1;
+    }
+    jc->coefs = jpeg_read_coefficients(cinfo);
+    return jc->coefs != NULL ? 1 : -1;
+}
+
+/**
+ * @brief Grow the thumbnail buffer to at least size bytes.
+ *
+ */
+static int jpegcoef_reserve(jpegcoef *jc, size_t size)
+{
+    if (size <= jc->out_sz)
+        return 1;
+    unsigned char *out = (unsigned char *)realloc(jc->out, size);
+    if (out == NULL)
+        return -1;
+    jc->out = out;
+    jc->out_sz = size;
+    return 1;
+}
+
+static inline unsigned char jpegcoef_clamp(int v)
+{
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+int jpegcoef_thumb(jpegcoef *jc, jpegdec_format format)
+{
+    struct jpeg_decompress_struct *cinfo = &(jc->cinfo);
+    if (jc->coefs == NULL)
+        return -1;
+    int ncomp = cinfo->num_components;
+    int color = cinfo->jpeg_color_space == JCS_YCbCr || cinfo->jpeg_color_space == JCS_RGB;
+    if ((ncomp != 1 && !(ncomp == 3 && color)) || (format != JPEGDEC_RGBX && format != JPEGDEC_RGB && format != JPEGDEC_GRAY))
+    {
+        fprintf(stderr, "%s: Unsupported image (%d components, color space %d) or format %s\n", __func__, ncomp, cinfo->jpeg_color_space, jpegdec_format_name(format));
+        return -1;
+    }
+    if (setjmp(jc->jerr.env))
+    {
+        jpegcoef_error(jc);
+        return -1;
+    }
+    int bpp = format == JPEGDEC_RGBX ? 4 : (format == JPEGDEC_RGB ? 3 : 1);
+    int width = (cinfo->image_width + DCTSIZE - 1) / DCTSIZE;
+    int height = (cinfo->image_height + DCTSIZE - 1) / DCTSIZE;
+    if (jpegcoef_reserve(jc, (size_t)width * height * bpp) < 0)
+        return -1;
+    jc->width = width;
+    jc->height = height;
+    jc->stride = width * bpp;
+    int nplanes = format == JPEGDEC_GRAY && cinfo->jpeg_color_space != JCS_RGB ? 1 : ncomp;
+    for (int y = 0; y < height; y++)
+    {
+        JBLOCKROW rows[3];
+        int dcq[3];
+        for (int c = 0; c < nplanes; c++)
+        {
+            jpeg_component_info *comp = &(cinfo->comp_info[c]);
+            JDIMENSION by = (JDIMENSION)y * comp->v_samp_factor / cinfo->max_v_samp_factor;
+            rows[c] = (*cinfo->mem->access_virt_barray)((j_common_ptr)cinfo, jc->coefs[c], by, 1, FALSE)[0];
+            dcq[c] = comp->quant_table->quantval[0];
+        }
+        unsigned char *out = &(jc->out[(size_t)y * jc->stride]);
+        for (int x = 0; x < width; x++)
+        {
+            int v[3];
+            for (int c = 0; c < nplanes; c++)
+            {
+                jpeg_component_info *comp = &(cinfo->comp_info[c]);
+                int bx = x * comp->h_samp_factor / cinfo->max_h_samp_factor;
+                v[c] = rows[c][bx][0] * dcq[c] / DCTSIZE + CENTERJSAMPLE; // block mean
+            }
+            if (nplanes == 1)
+                v[1] = v[2] = v[0];
+            else if (cinfo->jpeg_color_space == JCS_YCbCr)
+            {
+                int cb = v[1] - CENTERJSAMPLE, cr = v[2] - CENTERJSAMPLE;
+                int luma = v[0];
+                v[0] = luma + ((91881 * cr + 32768) >> 16);             // 1.402
+                v[1] = luma - ((22554 * cb + 46802 * cr - 32768) >> 16); // 0.34414, 0.71414
+                v[2] = luma + ((116130 * cb + 32768) >> 16);            // 1.772
+            }
+            if (format == JPEGDEC_GRAY)
+            {
+                // luminance of RGB JPEGs, Y of everything else
+                out[x] = jpegcoef_clamp(nplanes == 1 ? v[0] : (19595 * v[0] + 38470 * v[1] + 7471 * v[2] + 32768) >> 16);
+                continue;
+            }
+            out[x * bpp + 0] = jpegcoef_clamp(v[0]);
+            out[x * bpp + 1] = jpegcoef_clamp(v[1]);
+            out[x * bpp + 2] = jpegcoef_clamp(v[2]);
+            if (bpp == 4)
+                out[x * bpp + 3] = 0xff;
+        }
+    }
+    return 1;
+}
+
+int jpegcoef_sharpness(jpegcoef *jc, double *sharpness)
+{
+    struct jpeg_decompress_struct *cinfo = &(jc->cinfo);
+    if (jc->coefs == NULL)
+        return -1;
+    if (setjmp(jc->jerr.env))
+    {
+        jpegcoef_error(jc);
+        return -1;
+    }
+    // luminance (or the first component), where blur shows first
+    jpeg_component_info *comp = &(cinfo->comp_info[0]);
+    const UINT16 *q = comp->quant_table->quantval;
+    // sum the squares per coefficient position and dequantize once per frame; the
+    // loop has no branches and vectorizes, a row of squares fits 32 bits
+    uint64_t sum[DCTSIZE2] = {0};
+    for (JDIMENSION y = 0; y < comp->height_in_blocks; y++)
+    {
+        JBLOCKROW row = (*cinfo->mem->access_virt_barray)((j_common_ptr)cinfo, jc->coefs[0], y, 1, FALSE)[0];
+        uint32_t rsum[DCTSIZE2] = {0};
+        for (JDIMENSION x = 0; x < comp->width_in_blocks; x++)
+            for (int k = 0; k < DCTSIZE2; k++)
+                rsum[k] += (int32_t)row[x][k] * row[x][k];
+        for (int k = 0; k < DCTSIZE2; k++)
+            sum[k] += rsum[k];
+    }
+    double lo[2] = {0, 0}, hi[2] = {0, 0}; // horizontal, vertical
+    for (int k = 1; k < DCTSIZE2; k++) // natural order, k = v * 8 + u
+    {
+        double e = (double)sum[k] * q[k] * q[k];
+        int u = k % DCTSIZE, v = k / DCTSIZE;
+        if (u > 0)
+            *(u >= JPEGCOEF_SHARP_FREQ ? &hi[0] : &lo[0]) += e;
+        if (v > 0)
+            *(v >= JPEGCOEF_SHARP_FREQ ? &hi[1] : &lo[1]) += e;
+    }
+    // share of each direction's AC energy at high frequencies; blur along one
+    // direction, as from a tumble, removes it from that direction only
+    double score = 1;
+    for (int d = 0; d < 2; d++)
+    {
+        double r = lo[d] + hi[d] > 0 ? hi[d] / (lo[d] + hi[d]) : 0;
+        if (r < score)
+            score = r;
+    }
+    *sharpness = score;
+    return 1;
+}
+
+int jpegcoef_luma(jpegcoef *jc, ucam_luma *luma)
+{
+    struct jpeg_decompress_struct *cinfo = &(jc->cinfo);
+    if (jc->coefs == NULL)
+        return -1;
+    if (cinfo->jpeg_color_space != JCS_YCbCr && cinfo->jpeg_color_space != JCS_GRAYSCALE)
+    {
+        fprintf(stderr, "%s: No luminance component in color space %d\n", __func__, cinfo->jpeg_color_space);
+        return -1;
+    }
+    if (setjmp(jc->jerr.env))
+    {
+        jpegcoef_error(jc);
+        return -1;
+    }
+    jpeg_component_info *comp = &(cinfo->comp_info[0]);
+    int dcq = comp->quant_table->quantval[0];
+    memset(luma, 0x0, sizeof(ucam_luma));
+    unsigned long sum = 0, clipped = 0, crushed = 0;
+    for (JDIMENSION y = 0; y < comp->height_in_blocks; y++)
+    {
+        JBLOCKROW row = (*cinfo->mem->access_virt_barray)((j_common_ptr)cinfo, jc->coefs[0], y, 1, FALSE)[0];
+        for (JDIMENSION x = 0; x < comp->width_in_blocks; x++)
+        {
+            int v = jpegcoef_clamp(row[x][0] * dcq / DCTSIZE + CENTERJSAMPLE); // block mean
+            luma->hist[v * UCAM_LUMA_NBINS / 256]++;
+            sum += v;
+            clipped += v >= UCAM_LUMA_CLIP;
+            crushed += v <= UCAM_LUMA_CRUSH;
+        }
+    }
+    luma->nblocks = comp->width_in_blocks * comp->height_in_blocks;
+    if (luma->nblocks > 0)
+    {
+        luma->mean = (float)sum / luma->nblocks;
+        luma->clipped = (float)clipped / luma->nblocks;
+        luma->crushed = (float)crushed / luma->nblocks;
+    }
+    return 1;
+}
+
+void jpegcoef_done(jpegcoef *jc)
+{
+    if (jc->coefs == NULL)
+        return;
+    // releases the image pool, the decompress object stays ready for the next frame
+    if (setjmp(jc->jerr.env))
+    {
+        jpegcoef_error(jc);
+        return;
+    }
+    jpeg_finish_decompress(&(jc->cinfo));
+    jc->coefs = NULL;
+}
+
+void jpegcoef_destroy(jpegcoef *jc)
+{
+    jpeg_destroy_decompress(&(jc->cinfo));
+    jpegmem_destroy(&(jc->mem));
+    free(jc->out);
+    memset(jc, 0x0, sizeof(jpegcoef));
+}
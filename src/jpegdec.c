@@ -0,0 +1,499 @@
+/**
+ * @file jpegdec.c
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Long-lived JPEG decoder that keeps its libjpeg state and buffers across frames.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <jpegdec.h>
+#include <jerror.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+
+#if JPEG_LIB_VERSION >= 70
+#define JPEGDEC_DCT_H(comp) ((comp)->DCT_h_scaled_size)
+#define JPEGDEC_DCT_V(comp) ((comp)->DCT_v_scaled_size)
+#define JPEGDEC_MIN_DCT_V(cinfo) ((cinfo)->min_DCT_v_scaled_size)
+#else
+#define JPEGDEC_DCT_H(comp) ((comp)->DCT_scaled_size)
+#define JPEGDEC_DCT_V(comp) ((comp)->DCT_scaled_size)
+#define JPEGDEC_MIN_DCT_V(cinfo) ((cinfo)->min_DCT_scaled_size)
+#endif
+
+/**
+ * @brief Decompression parameters of each jpegdec_profile.
+ *
+ */
+static const struct
+{
+    const char *name;
+    J_DCT_METHOD dct_method;
+    boolean do_fancy_upsampling;
+    boolean do_block_smoothing;
+} jpegdec_profiles[JPEGDEC_NPROFILES] = {
+    {"preview", JDCT_IFAST, FALSE, FALSE},
+    {"display", JDCT_ISLOW, FALSE, FALSE},
+    {"full", JDCT_ISLOW, TRUE, TRUE},
+};
+
+const char *jpegdec_profile_name(jpegdec_profile profile)
+{
+    if (profile < 0 || profile >= JPEGDEC_NPROFILES)
+        return "unknown";
+    return jpegdec_profiles[profile].name;
+}
+
+/**
+ * @brief libjpeg output color space of each jpegdec_format.
+ *
+ */
+static const struct
+{
+    const char *name;
+    J_COLOR_SPACE color_space;
+    int raw;
+} jpegdec_formats[JPEGDEC_NFORMATS] = {
+    {"RGBX", JCS_EXT_RGBX, 0},
+    {"RGB", JCS_EXT_RGB, 0},
+    {"GRAY", JCS_GRAYSCALE, 0},
+    {"YCbCr", JCS_YCbCr, 1},
+};
+
+const char *jpegdec_format_name(jpegdec_format format)
+{
+    if (format < 0 || format >= JPEGDEC_NFORMATS)
+        return "unknown";
+    return jpegdec_formats[format].name;
+}
+
+/* Source manager over a buffer that fills up while the image is decoded. The
+ * decompress object is the first member of jpegdec, so the callbacks find the
+ * decoder from cinfo. libjpeg never copies the input: on suspension it rewinds
+ * next_input_byte to the last point it can restart from, which still points into
+ * the buffer, and jpegdec_src_sync extends bytes_in_buffer from there when more
+ * data arrives.
+ */
+static void jpegdec_init_source(j_decompress_ptr cinfo)
+{
+}
+
+static boolean jpegdec_fill_input_buffer(j_decompress_ptr cinfo)
+{
+    static const JOCTET fake_eoi[2] = {0xFF, JPEG_EOI};
+    jpegdec *dec = (jpegdec *)cinfo;
+    if (!dec->stream_eof)
+        return FALSE; // suspend until the next package arrives
+    // the image ended early, insert a fake EOI marker like jpeg_mem_src does
+    WARNMS(cinfo, JWRN_JPEG_EOF);
+    dec->src.next_input_byte = fake_eoi;
+    dec->src.bytes_in_buffer = 2;
+    return TRUE;
+}
+
+static void jpegdec_skip_input_data(j_decompress_ptr cinfo, long num_bytes)
+{
+    jpegdec *dec = (jpegdec *)cinfo;
+    if (num_bytes <= 0)
+        return;
+    if ((size_t)num_bytes > dec->src.bytes_in_buffer)
+    {
+        // skip the rest once it has arrived
+        dec->stream_skip += num_bytes - dec->src.bytes_in_buffer;
+        num_bytes = dec->src.bytes_in_buffer;
+    }
+    dec->src.next_input_byte += num_bytes;
+    dec->src.bytes_in_buffer -= num_bytes;
+}
+
+static void jpegdec_term_source(j_decompress_ptr cinfo)
+{
+}
+
+/**
+ * @brief Make the bytes that arrived since the last call available to libjpeg.
+ *
+ */
+static void jpegdec_src_sync(jpegdec *dec)
+{
+    const unsigned char *next = dec->src.next_input_byte;
+    if (next < dec->stream_buf || next > dec->stream_buf + dec->stream_len)
+        return; // reading the fake EOI
+    size_t pos = next - dec->stream_buf;
+    size_t skip = dec->stream_len - pos < dec->stream_skip ? dec->stream_len - pos : dec->stream_skip;
+    pos += skip;
+    dec->stream_skip -= skip;
+    dec->src.next_input_byte = dec->stream_buf + pos;
+    dec->src.bytes_in_buffer = dec->stream_len - pos;
+}
+
+/**
+ * @brief Fatal libjpeg errors return to the setjmp in the jpegdec function that
+ * called into libjpeg instead of exiting.
+ *
+ */
+static void jpegdec_error_exit(j_common_ptr cinfo)
+{
+    jpegdec_err *err = (jpegdec_err *)cinfo->err;
+    longjmp(err->env, 1);
+}
+
+void jpegdec_err_init(jpegdec_err *err, j_common_ptr cinfo)
+{
+    cinfo->err = jpeg_std_error(&(err->pub));
+    err->pub.error_exit = jpegdec_error_exit;
+}
+
+void jpegdec_err_caught(jpegdec_err *err, j_common_ptr cinfo, jpegmem *mem)
+{
+    jpegmem_recover(mem, cinfo);
+    (*cinfo->err->format_message)(cinfo, err->msg);
+    (*cinfo->err->output_message)(cinfo);
+}
+
+/**
+ * @brief Report the libjpeg error that was raised, and count it.
+ *
+ */
+static void jpegdec_error(jpegdec *dec)
+{
+    jpegdec_err_caught(&(dec->jerr), (j_common_ptr) & (dec->cinfo), &(dec->mem));
+    dec->nerrors++;
+}
+
+int jpegdec_init(jpegdec *dec, ucam_arena *arena)
+{
+    memset(dec, 0x0, sizeof(jpegdec));
+    dec->arena = arena;
+    dec->profile = JPEGDEC_FULL;
+    jpegdec_err_init(&(dec->jerr), (j_common_ptr) & (dec->cinfo));
+    if (setjmp(dec->jerr.env))
+    {
+        jpegdec_error(dec);
+        jpeg_destroy_decompress(&(dec->cinfo));
+        return -1;
+    }
+    jpeg_create_decompress(&(dec->cinfo));
+    if (jpegmem_init(&(dec->mem), arena, JPEGMEM_ARENA_SZ) > 0)
+        jpegmem_attach(&(dec->mem), (j_common_ptr) & (dec->cinfo));
+    else
+        fprintf(stderr, "%s: Using libjpeg's memory manager\n", __func__);
+    dec->src.init_source = jpegdec_init_source;
+    dec->src.fill_input_buffer = jpegdec_fill_input_buffer;
+    dec->src.skip_input_data = jpegdec_skip_input_data;
+    dec->src.resync_to_restart = jpeg_resync_to_restart;
+    dec->src.term_source = jpegdec_term_source;
+    dec->cinfo.src = &(dec->src);
+    return 1;
+}
+
+/**
+ * @brief Make sure the output buffer holds at least size bytes and the row
+ * pointer array has room for rows entries. Buffers from the arena are not
+ * returned, so both only ever grow.
+ *
+ */
+static int jpegdec_reserve(jpegdec *dec, size_t size, int rows)
+{
+    if (size <= dec->out_sz && rows <= dec->rows_cap)
+        return 1;
+    if (dec->out_ext && size > dec->out_sz)
+        return -1; // the caller's buffer is too small
+    unsigned char *out = NULL;
+    JSAMPROW *rowptr = NULL;
+    if (dec->arena != NULL)
+    {
+        out = size > dec->out_sz ? (unsigned char *)ucam_arena_alloc(dec->arena, size) : dec->out;
+        rowptr = rows > dec->rows_cap ? (JSAMPROW *)ucam_arena_alloc(dec->arena, rows * sizeof(JSAMPROW)) : dec->rows;
+        if (out == NULL || rowptr == NULL)
+        {
+            fprintf(stderr, "%s: Arena exhausted, allocating %s from the heap\n", __func__, dec->out_ext ? "row pointers" : "buffers");
+            dec->arena = NULL; // from now on the buffers live on the heap
+            if (!dec->out_ext) // the caller's buffer is big enough, only the row pointers move
+            {
+                dec->out = NULL;
+                dec->out_sz = 0;
+            }
+            dec->rows = NULL;
+            dec->rows_cap = 0;
+            out = NULL;
+            rowptr = NULL;
+        }
+    }
+    if (out == NULL)
+        out = size > dec->out_sz ? (unsigned char *)realloc(dec->out, size) : dec->out;
+    if (out == NULL)
+        return -1;
+    dec->out = out;
+    if (size > dec->out_sz)
+    {
+        dec->out_sz = size;
+        dec->ngrow++;
+    }
+    if (rowptr == NULL)
+        rowptr = rows > dec->rows_cap ? (JSAMPROW *)realloc(dec->rows, rows * sizeof(JSAMPROW)) : dec->rows;
+    if (rowptr == NULL)
+        return -1;
+    dec->rows = rowptr;
+    if (rows > dec->rows_cap)
+        dec->rows_cap = rows;
+    return 1;
+}
+
+/**
+ * @brief Lay out the output of the image that was just started in dec->out and
+ * point the row pointers at it. Interleaved formats get one row per output
+ * line. Raw YCbCr gets one plane per component, each padded to whole DCT blocks
+ * and iMCU rows as jpeg_read_raw_data writes them.
+ *
+ */
+static int jpegdec_layout(jpegdec *dec)
+{
+    struct jpeg_decompress_struct *cinfo = &(dec->cinfo);
+    dec->width = cinfo->output_width;
+    dec->height = cinfo->output_height;
+    if (!cinfo->raw_data_out)
+    {
+        int row_stride = cinfo->output_width * cinfo->output_components;
+        if (jpegdec_reserve(dec, (size_t)row_stride * cinfo->output_height, cinfo->output_height) < 0)
+            return -1;
+        // libjpeg writes straight into the output image, as many rows per call as it has ready
+        for (JDIMENSION i = 0; i < cinfo->output_height; i++)
+            dec->rows[i] = &(dec->out[(size_t)i * row_stride]);
+        dec->stride = row_stride;
+        dec->ncomp = 0;
+        return 1;
+    }
+    size_t size = 0;
+    int nrows = 0;
+    int stride[JPEGDEC_MAX_PLANES], height[JPEGDEC_MAX_PLANES];
+    dec->ncomp = cinfo->num_components < JPEGDEC_MAX_PLANES ? cinfo->num_components : JPEGDEC_MAX_PLANES;
+    for (int c = 0; c < dec->ncomp; c++)
+    {
+        jpeg_component_info *comp = &(cinfo->comp_info[c]);
+        stride[c] = comp->width_in_blocks * JPEGDEC_DCT_H(comp);
+        height[c] = cinfo->total_iMCU_rows * comp->v_samp_factor * JPEGDEC_DCT_V(comp);
+        size += (size_t)stride[c] * height[c];
+        nrows += height[c];
+    }
+    if (jpegdec_reserve(dec, size, nrows) < 0)
+        return -1;
+    size_t offset = 0;
+    nrows = 0;
+    for (int c = 0; c < dec->ncomp; c++)
+    {
+        jpeg_component_info *comp = &(cinfo->comp_info[c]);
+        dec->plane[c] = &(dec->out[offset]);
+        dec->plane_rows[c] = &(dec->rows[nrows]);
+        dec->plane_w[c] = comp->downsampled_width;
+        dec->plane_h[c] = comp->downsampled_height;
+        dec->plane_stride[c] = stride[c];
+        for (int i = 0; i < height[c]; i++)
+            dec->rows[nrows + i] = &(dec->out[offset + (size_t)i * stride[c]]);
+        offset += (size_t)stride[c] * height[c];
+        nrows += height[c];
+    }
+    dec->stride = stride[0];
+    return 1;
+}
+
+int jpegdec_scale_denom(int width, int height, int view_w, int view_h)
+{
+    if (view_w <= 0 || view_h <= 0)
+        return 1;
+    int denom = 8;
+    while (denom > 1 && ((width + denom - 1) / denom < view_w || (height + denom - 1) / denom < view_h))
+        denom >>= 1;
+    return denom;
+}
+
+void jpegdec_stream_begin(jpegdec *dec, const unsigned char *jpg)
+{
+    if (dec->state != JPEGDEC_IDLE && dec->state != JPEGDEC_DONE)
+        jpeg_abort_decompress(&(dec->cinfo)); // the last image was never completed
+    dec->stream_buf = jpg;
+    dec->stream_len = 0;
+    dec->stream_skip = 0;
+    dec->stream_eof = 0;
+    dec->src.next_input_byte = jpg;
+    dec->src.bytes_in_buffer = 0;
+    dec->nrows = 0;
+    dec->state = JPEGDEC_HEADER;
+}
+
+int jpegdec_stream_feed(jpegdec *dec, size_t len, int last)
+{
+    struct jpeg_decompress_struct *cinfo = &(dec->cinfo);
+    dec->stream_len = len;
+    dec->stream_eof = last;
+    jpegdec_src_sync(dec);
+    if (dec->state == JPEGDEC_IDLE || dec->state == JPEGDEC_DONE)
+        return -1;
+    if (setjmp(dec->jerr.env))
+    {
+        // the first dec->nrows rows of out are still good
+        jpegdec_error(dec);
+        jpeg_abort_decompress(cinfo);
+        dec->state = JPEGDEC_IDLE;
+        return -1;
+    }
+    switch (dec->state)
+    {
+    case JPEGDEC_HEADER:
+    {
+        int ret = jpeg_read_header(cinfo, TRUE);
+        if (ret == JPEG_SUSPENDED)
+            return 0;
+        if (ret != JPEG_HEADER_OK)
+        {
+            jpeg_abort_decompress(cinfo);
+            dec->state = JPEGDEC_IDLE;
+            return -1;
+        }
+        // jpeg_read_header resets the decompression parameters, set the ones we change
+        jpegdec_format format = dec->format >= 0 && dec->format < JPEGDEC_NFORMATS ? dec->format : JPEGDEC_RGBX;
+        cinfo->out_color_space = jpegdec_formats[format].color_space;
+        cinfo->raw_data_out = jpegdec_formats[format].raw;
+        if (cinfo->raw_data_out && cinfo->jpeg_color_space != JCS_YCbCr)
+            cinfo->out_color_space = cinfo->jpeg_color_space; // planes as stored, e.g. a grayscale JPEG
+        dec->img_width = cinfo->image_width;
+        dec->img_height = cinfo->image_height;
+        dec->scale_denom = jpegdec_scale_denom(cinfo->image_width, cinfo->image_height, dec->view_w, dec->view_h);
+        cinfo->scale_num = 1;
+        cinfo->scale_denom = dec->scale_denom;
+        if (dec->profile >= 0 && dec->profile < JPEGDEC_NPROFILES)
+        {
+            cinfo->dct_method = jpegdec_profiles[dec->profile].dct_method;
+            cinfo->do_fancy_upsampling = jpegdec_profiles[dec->profile].do_fancy_upsampling;
+            cinfo->do_block_smoothing = jpegdec_profiles[dec->profile].do_block_smoothing;
+        }
+        dec->state = JPEGDEC_START;
+    }
+    // fall through
+    case JPEGDEC_START:
+        if (!jpeg_start_decompress(cinfo))
+            return 0;
+        if (jpegdec_layout(dec) < 0)
+        {
+            fprintf(stderr, "%s: Could not allocate %d x %d output\n", __func__, cinfo->output_width, cinfo->output_height);
+            jpeg_abort_decompress(cinfo);
+            dec->state = JPEGDEC_IDLE;
+            return -1;
+        }
+        dec->state = JPEGDEC_SCAN;
+    // fall through
+    case JPEGDEC_SCAN:
+        while (cinfo->output_scanline < cinfo->output_height)
+        {
+            JDIMENSION n;
+            if (cinfo->raw_data_out)
+            {
+                // one iMCU row of every plane per call
+                JSAMPARRAY planes[JPEGDEC_MAX_PLANES];
+                int imcu = cinfo->output_scanline / (cinfo->max_v_samp_factor * JPEGDEC_MIN_DCT_V(cinfo));
+                for (int c = 0; c < dec->ncomp; c++)
+                {
+                    int lines = cinfo->comp_info[c].v_samp_factor * JPEGDEC_DCT_V(&(cinfo->comp_info[c]));
+                    planes[c] = &(dec->plane_rows[c][imcu * lines]);
+                }
+                n = jpeg_read_raw_data(cinfo, planes, cinfo->max_v_samp_factor * JPEGDEC_MIN_DCT_V(cinfo));
+            }
+            else
+                n = jpeg_read_scanlines(cinfo, &(dec->rows[cinfo->output_scanline]), cinfo->output_height - cinfo->output_scanline);
+            dec->nreads++;
+            if (n == 0)
+                return 0; // out of data, the rows decoded so far are in out
+            dec->nrows = cinfo->output_scanline < cinfo->output_height ? cinfo->output_scanline : cinfo->output_height;
+        }
+        dec->state = JPEGDEC_FINISH;
+    // fall through
+    case JPEGDEC_FINISH:
+        // releases the image pool, the decompress object stays ready for the next frame
+        if (!jpeg_finish_decompress(cinfo))
+            return 0;
+        dec->nframes++;
+        dec->state = JPEGDEC_DONE;
+        return 1;
+    default:
+        return -1;
+    }
+}
+
+int jpegdec_decode(jpegdec *dec, const unsigned char *jpg, size_t len)
+{
+    jpegdec_stream_begin(dec, jpg);
+    return jpegdec_stream_feed(dec, len, 1) > 0 ? 1 : -1;
+}
+
+int jpegdec_tables(jpegdec *dec, const unsigned char *tables, size_t len)
+{
+    jpegdec_stream_begin(dec, tables);
+    dec->stream_len = len;
+    dec->stream_eof = 1;
+    jpegdec_src_sync(dec);
+    dec->state = JPEGDEC_IDLE; // no image follows
+    if (setjmp(dec->jerr.env))
+    {
+        jpegdec_error(dec);
+        jpeg_abort_decompress(&(dec->cinfo));
+        return -1;
+    }
+    if (jpeg_read_header(&(dec->cinfo), FALSE) != JPEG_HEADER_TABLES_ONLY)
+    {
+        fprintf(stderr, "%s: Not a tables-only datastream\n", __func__);
+        jpeg_abort_decompress(&(dec->cinfo));
+        return -1;
+    }
+    return 1;
+}
+
+void jpegdec_set_output(jpegdec *dec, unsigned char *out, size_t size)
+{
+    if (!dec->out_ext && dec->arena == NULL)
+        free(dec->out);
+    dec->out = out;
+    dec->out_sz = out != NULL ? size : 0;
+    dec->out_ext = out != NULL;
+}
+
+void jpegdec_destroy(jpegdec *dec)
+{
+    jpeg_destroy_decompress(&(dec->cinfo));
+    jpegmem_destroy(&(dec->mem));
+    if (dec->arena == NULL)
+    {
+        if (!dec->out_ext)
+            free(dec->out);
+        free(dec->rows);
+    }
+    memset(dec, 0x0, sizeof(jpegdec));
+}
+
+int jpegdec_read_file(const char *fname, unsigned char **jpg, size_t *len)
+{
+    FILE *fp = fopen(fname, "rb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "%s: Can't open %s\n", __func__, fname);
+        return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    long sz = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    unsigned char *buf = sz > 0 ? (unsigned char *)malloc(sz) : NULL;
+    if (buf == NULL || fread(buf, 1, sz, fp) != (size_t)sz)
+    {
+        fprintf(stderr, "%s: Can't read %s\n", __func__, fname);
+        free(buf);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    *jpg = buf;
+    *len = sz;
+    return 1;
+}
@@ -0,0 +1,262 @@
+/**
+ * @file jpegmem.c
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Arena-backed libjpeg memory manager that is reset, not freed, between frames.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <jpegmem.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <jerror.h>
+
+/**
+ * @brief Sample rows are padded to this many bytes, as libjpeg-turbo's SIMD
+ * routines may read and write past the end of a row up to this boundary.
+ *
+ */
+#define JPEGMEM_ROW_ALIGN 64
+
+/**
+ * @brief Virtual arrays live entirely in memory, libjpeg only requests them in
+ * JPOOL_IMAGE so they are always released with the arena.
+ *
+ */
+struct jvirt_sarray_control
+{
+    JSAMPARRAY mem_buffer;     /// rows of the array, NULL until realized
+    JDIMENSION rows_in_array;  /// total virtual array height
+    JDIMENSION samplesperrow;  /// width of array (and of memory buffer)
+    JDIMENSION maxaccess;      /// max rows accessed by access_virt_sarray
+    boolean pre_zero;          /// zero the array when it is realized
+    struct jvirt_sarray_control *next;
+};
+
+struct jvirt_barray_control
+{
+    JBLOCKARRAY mem_buffer;    /// rows of the array, NULL until realized
+    JDIMENSION rows_in_array;  /// total virtual array height
+    JDIMENSION blocksperrow;   /// width of array (and of memory buffer)
+    JDIMENSION maxaccess;      /// max rows accessed by access_virt_barray
+    boolean pre_zero;          /// zero the array when it is realized
+    struct jvirt_barray_control *next;
+};
+
+#define JPEGMEM_SELF(cinfo) ((jpegmem *)((cinfo)->mem))
+
+/**
+ * @brief Run a method of libjpeg's own manager. Its methods find their private
+ * state through cinfo->mem, so it has to be swapped in for the duration of the call.
+ *
+ */
+#define JPEGMEM_SYS(cinfo, mem, call)  \
+    do                                 \
+    {                                  \
+        (cinfo)->mem = (mem)->sys;     \
+        call;                          \
+        (cinfo)->mem = &((mem)->pub);  \
+    } while (0)
+
+static void *jpegmem_get(j_common_ptr cinfo, int pool_id, size_t size, int large)
+{
+    jpegmem *mem = JPEGMEM_SELF(cinfo);
+    void *ptr = NULL;
+    if (pool_id == JPOOL_IMAGE)
+        ptr = ucam_arena_alloc(&(mem->arena), size);
+    else if (pool_id != JPOOL_PERMANENT)
+        ERREXIT1(cinfo, JERR_BAD_POOL_ID, pool_id);
+    if (ptr != NULL)
+    {
+        mem->n_arena++;
+        return ptr;
+    }
+    mem->n_sys++;
+    if (large)
+        JPEGMEM_SYS(cinfo, mem, ptr = (*mem->sys->alloc_large)(cinfo, pool_id, size));
+    else
+        JPEGMEM_SYS(cinfo, mem, ptr = (*mem->sys->alloc_small)(cinfo, pool_id, size));
+    return ptr;
+}
+
+static void *jpegmem_alloc_small(j_common_ptr cinfo, int pool_id, size_t sizeofobject)
+{
+    return jpegmem_get(cinfo, pool_id, sizeofobject, 0);
+}
+
+static void *jpegmem_alloc_large(j_common_ptr cinfo, int pool_id, size_t sizeofobject)
+{
+    return jpegmem_get(cinfo, pool_id, sizeofobject, 1);
+}
+
+static JSAMPARRAY jpegmem_alloc_sarray(j_common_ptr cinfo, int pool_id, JDIMENSION samplesperrow, JDIMENSION numrows)
+{
+    size_t rowsize = ((size_t)samplesperrow * sizeof(JSAMPLE) + JPEGMEM_ROW_ALIGN - 1) & ~((size_t)JPEGMEM_ROW_ALIGN - 1);
+    if (numrows > 0 && rowsize > ((size_t)-1) / numrows)
+        ERREXIT(cinfo, JERR_WIDTH_OVERFLOW);
+    JSAMPARRAY result = (JSAMPARRAY)jpegmem_get(cinfo, pool_id, numrows * sizeof(JSAMPROW), 0);
+    JSAMPLE *workspace = (JSAMPLE *)jpegmem_get(cinfo, pool_id, rowsize * numrows, 1);
+    for (JDIMENSION i = 0; i < numrows; i++)
+        result[i] = workspace + i * rowsize;
+    return result;
+}
+
+static JBLOCKARRAY jpegmem_alloc_barray(j_common_ptr cinfo, int pool_id, JDIMENSION blocksperrow, JDIMENSION numrows)
+{
+    size_t rowsize = (size_t)blocksperrow * sizeof(JBLOCK);
+    if (numrows > 0 && rowsize > ((size_t)-1) / numrows)
+        ERREXIT(cinfo, JERR_WIDTH_OVERFLOW);
+    JBLOCKARRAY result = (JBLOCKARRAY)jpegmem_get(cinfo, pool_id, numrows * sizeof(JBLOCKROW), 0);
+    JBLOCKROW workspace = (JBLOCKROW)jpegmem_get(cinfo, pool_id, rowsize * numrows, 1);
+    for (JDIMENSION i = 0; i < numrows; i++)
+        result[i] = workspace + i * blocksperrow;
+    return result;
+}
+
+static jvirt_sarray_ptr jpegmem_request_virt_sarray(j_common_ptr cinfo, int pool_id, boolean pre_zero, JDIMENSION samplesperrow, JDIMENSION numrows, JDIMENSION maxaccess)
+{
+    jpegmem *mem = JPEGMEM_SELF(cinfo);
+    if (pool_id != JPOOL_IMAGE)
+        ERREXIT1(cinfo, JERR_BAD_POOL_ID, pool_id);
+    jvirt_sarray_ptr result = (jvirt_sarray_ptr)jpegmem_get(cinfo, pool_id, sizeof(struct jvirt_sarray_control), 0);
+    result->mem_buffer = NULL;
+    result->rows_in_array = numrows;
+    result->samplesperrow = samplesperrow;
+    result->maxaccess = maxaccess;
+    result->pre_zero = pre_zero;
+    result->next = mem->virt_sarray;
+    mem->virt_sarray = result;
+    return result;
+}
+
+static jvirt_barray_ptr jpegmem_request_virt_barray(j_common_ptr cinfo, int pool_id, boolean pre_zero, JDIMENSION blocksperrow, JDIMENSION numrows, JDIMENSION maxaccess)
+{
+    jpegmem *mem = JPEGMEM_SELF(cinfo);
+    if (pool_id != JPOOL_IMAGE)
+        ERREXIT1(cinfo, JERR_BAD_POOL_ID, pool_id);
+    jvirt_barray_ptr result = (jvirt_barray_ptr)jpegmem_get(cinfo, pool_id, sizeof(struct jvirt_barray_control), 0);
+    result->mem_buffer = NULL;
+    result->rows_in_array = numrows;
+    result->blocksperrow = blocksperrow;
+    result->maxaccess = maxaccess;
+    result->pre_zero = pre_zero;
+    result->next = mem->virt_barray;
+    mem->virt_barray = result;
+    return result;
+}
+
+static void jpegmem_realize_virt_arrays(j_common_ptr cinfo)
+{
+    jpegmem *mem = JPEGMEM_SELF(cinfo);
+    for (jvirt_sarray_ptr sptr = mem->virt_sarray; sptr != NULL; sptr = sptr->next)
+    {
+        if (sptr->mem_buffer != NULL)
+            continue;
+        sptr->mem_buffer = jpegmem_alloc_sarray(cinfo, JPOOL_IMAGE, sptr->samplesperrow, sptr->rows_in_array);
+        if (sptr->pre_zero)
+            for (JDIMENSION i = 0; i < sptr->rows_in_array; i++)
+                memset(sptr->mem_buffer[i], 0x0, sptr->samplesperrow * sizeof(JSAMPLE));
+    }
+    for (jvirt_barray_ptr bptr = mem->virt_barray; bptr != NULL; bptr = bptr->next)
+    {
+        if (bptr->mem_buffer != NULL)
+            continue;
+        bptr->mem_buffer = jpegmem_alloc_barray(cinfo, JPOOL_IMAGE, bptr->blocksperrow, bptr->rows_in_array);
+        if (bptr->pre_zero)
+            for (JDIMENSION i = 0; i < bptr->rows_in_array; i++)
+                memset(bptr->mem_buffer[i], 0x0, bptr->blocksperrow * sizeof(JBLOCK));
+    }
+}
+
+static JSAMPARRAY jpegmem_access_virt_sarray(j_common_ptr cinfo, jvirt_sarray_ptr ptr, JDIMENSION start_row, JDIMENSION num_rows, boolean writable)
+{
+    if (ptr->mem_buffer == NULL || num_rows > ptr->maxaccess || start_row + num_rows > ptr->rows_in_array)
+        ERREXIT(cinfo, JERR_BAD_VIRTUAL_ACCESS);
+    return ptr->mem_buffer + start_row;
+}
+
+static JBLOCKARRAY jpegmem_access_virt_barray(j_common_ptr cinfo, jvirt_barray_ptr ptr, JDIMENSION start_row, JDIMENSION num_rows, boolean writable)
+{
+    if (ptr->mem_buffer == NULL || num_rows > ptr->maxaccess || start_row + num_rows > ptr->rows_in_array)
+        ERREXIT(cinfo, JERR_BAD_VIRTUAL_ACCESS);
+    return ptr->mem_buffer + start_row;
+}
+
+static void jpegmem_free_pool(j_common_ptr cinfo, int pool_id)
+{
+    jpegmem *mem = JPEGMEM_SELF(cinfo);
+    if (pool_id == JPOOL_IMAGE)
+    {
+        mem->virt_sarray = NULL;
+        mem->virt_barray = NULL;
+        ucam_arena_reset(&(mem->arena));
+        mem->n_reset++;
+    }
+    // image requests that did not fit in the arena live in libjpeg's pool
+    JPEGMEM_SYS(cinfo, mem, (*mem->sys->free_pool)(cinfo, pool_id));
+}
+
+static void jpegmem_self_destruct(j_common_ptr cinfo)
+{
+    jpegmem *mem = JPEGMEM_SELF(cinfo);
+    mem->virt_sarray = NULL;
+    mem->virt_barray = NULL;
+    ucam_arena_reset(&(mem->arena));
+    mem->sys->max_memory_to_use = mem->pub.max_memory_to_use;
+    cinfo->mem = mem->sys;
+    (*mem->sys->self_destruct)(cinfo); // clears cinfo->mem
+    mem->sys = NULL;
+}
+
+int jpegmem_init(jpegmem *mem, ucam_arena *parent, size_t size)
+{
+    int status;
+    memset(mem, 0x0, sizeof(jpegmem));
+    if (parent != NULL)
+        status = ucam_arena_sub(parent, &(mem->arena), size);
+    else
+        status = ucam_arena_init(&(mem->arena), size, UCAM_ARENA_ALL);
+    if (status < 0)
+    {
+        fprintf(stderr, "%s: Could not set up %zu byte arena\n", __func__, size);
+        return status;
+    }
+    mem->pub.alloc_small = jpegmem_alloc_small;
+    mem->pub.alloc_large = jpegmem_alloc_large;
+    mem->pub.alloc_sarray = jpegmem_alloc_sarray;
+    mem->pub.alloc_barray = jpegmem_alloc_barray;
+    mem->pub.request_virt_sarray = jpegmem_request_virt_sarray;
+    mem->pub.request_virt_barray = jpegmem_request_virt_barray;
+    mem->pub.realize_virt_arrays = jpegmem_realize_virt_arrays;
+    mem->pub.access_virt_sarray = jpegmem_access_virt_sarray;
+    mem->pub.access_virt_barray = jpegmem_access_virt_barray;
+    mem->pub.free_pool = jpegmem_free_pool;
+    mem->pub.self_destruct = jpegmem_self_destruct;
+    return 1;
+}
+
+void jpegmem_attach(jpegmem *mem, j_common_ptr cinfo)
+{
+    mem->sys = cinfo->mem;
+    mem->pub.max_memory_to_use = mem->sys->max_memory_to_use;
+    mem->pub.max_alloc_chunk = mem->sys->max_alloc_chunk;
+    mem->virt_sarray = NULL;
+    mem->virt_barray = NULL;
+    ucam_arena_reset(&(mem->arena));
+    cinfo->mem = &(mem->pub);
+}
+
+void jpegmem_recover(jpegmem *mem, j_common_ptr cinfo)
+{
+    // JPEGMEM_SYS did not get to swap the manager back
+    if (mem->sys != NULL && cinfo->mem == mem->sys)
+        cinfo->mem = &(mem->pub);
+}
+
+void jpegmem_destroy(jpegmem *mem)
+{
+    ucam_arena_destroy(&(mem->arena));
+}
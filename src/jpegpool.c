@@ -0,0 +1,232 @@
+/**
+ * @file jpegpool.c
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Decode service with a fixed pool of worker threads and pooled output buffers.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <jpegpool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#define JPEGPOOL_OF(frame) ((jpegpool *)((char *)((frame)->pool) - offsetof(jpegpool, bufs))) /// Service an output buffer belongs to
+
+/**
+ * @brief Job a runs before job b.
+ *
+ */
+static inline int jpegpool_before(const jpegpool_job *a, const jpegpool_job *b)
+{
+    return a->priority > b->priority || (a->priority == b->priority && a->seq < b->seq);
+}
+
+static void jpegpool_push(jpegpool *pool, jpegpool_job *job)
+{
+    int i = pool->qlen++;
+    while (i > 0 && jpegpool_before(job, pool->queue[(i - 1) / 2]))
+    {
+        pool->queue[i] = pool->queue[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    pool->queue[i] = job;
+}
+
+static jpegpool_job *jpegpool_pop(jpegpool *pool)
+{
+    jpegpool_job *top = pool->queue[0];
+    jpegpool_job *last = pool->queue[--pool->qlen];
+    int i = 0;
+    for (;;)
+    {
+        int c = 2 * i + 1;
+        if (c >= pool->qlen)
+            break;
+        if (c + 1 < pool->qlen && jpegpool_before(pool->queue[c + 1], pool->queue[c]))
+            c++;
+        if (!jpegpool_before(pool->queue[c], last))
+            break;
+        pool->queue[i] = pool->queue[c];
+        i = c;
+    }
+    pool->queue[i] = last;
+    return top;
+}
+
+static void *jpegpool_thread(void *arg)
+{
+    jpegpool *pool = (jpegpool *)((jpegpool_worker *)arg)->pool;
+    int id = ((jpegpool_worker *)arg)->id;
+    jpegdec *dec = &(pool->decs[id]);
+    for (;;)
+    {
+        // take the output buffer before the job, so that no worker holds a job
+        // it cannot start; jpegpool_release signals when a buffer comes back
+        ucam_frame *out = NULL;
+        pthread_mutex_lock(&(pool->lock));
+        for (;;)
+        {
+            if (pool->qlen > 0 && (out = ucam_frame_get(&(pool->bufs))) != NULL)
+                break;
+            if (pool->qlen == 0 && pool->stop)
+                break;
+            pthread_cond_wait(&(pool->work), &(pool->lock));
+        }
+        if (out == NULL) // stopping and nothing left to do
+        {
+            pthread_mutex_unlock(&(pool->lock));
+            break;
+        }
+        jpegpool_job *job = jpegpool_pop(pool);
+        job->out = out;
+        pool->busy++;
+        pthread_mutex_unlock(&(pool->lock));
+
+        dec->format = job->format;
+        dec->profile = job->profile;
+        dec->view_w = job->view_w;
+        dec->view_h = job->view_h;
+        jpegdec_set_output(dec, job->out->data, job->out->cap);
+        job->status = jpegdec_decode(dec, job->jpg, job->len);
+        job->worker = id;
+        if (job->status > 0)
+        {
+            job->width = dec->width;
+            job->height = dec->height;
+            job->stride = dec->stride;
+            job->out->len = (ssize_t)dec->stride * dec->height;
+        }
+        else // no output, give the buffer back to the next job
+            jpegpool_release(job);
+        if (job->done != NULL)
+            job->done(job, job->user);
+
+        pthread_mutex_lock(&(pool->lock));
+        pool->busy--;
+        pool->ndone++;
+        pthread_cond_broadcast(&(pool->idle));
+        pthread_mutex_unlock(&(pool->lock));
+    }
+    return NULL;
+}
+
+int jpegpool_init(jpegpool *pool, int nworkers, int qcap, int nbufs, size_t buf_sz, ucam_arena *arena)
+{
+    if (pool == NULL || nworkers < 1 || nworkers > JPEGPOOL_MAX_WORKERS || qcap < 1)
+        return -1;
+    memset(pool, 0x0, sizeof(jpegpool));
+    pool->queue = (jpegpool_job **)malloc(qcap * sizeof(jpegpool_job *));
+    if (pool->queue == NULL)
+        return -1;
+    pool->qcap = qcap;
+    if (ucam_frame_pool_init(&(pool->bufs), nbufs, buf_sz, arena) < 0)
+    {
+        free(pool->queue);
+        return -1;
+    }
+    pthread_mutex_init(&(pool->lock), NULL);
+    pthread_cond_init(&(pool->work), NULL);
+    pthread_cond_init(&(pool->idle), NULL);
+    for (int i = 0; i < nworkers; i++)
+    {
+        // every worker maps a private arena for libjpeg, the output goes to the pooled buffers
+        if (jpegdec_init(&(pool->decs[i]), NULL) < 0)
+            break;
+        pool->workers[i].pool = pool;
+        pool->workers[i].id = i;
+        if (pthread_create(&(pool->threads[i]), NULL, jpegpool_thread, &(pool->workers[i])) != 0)
+        {
+            jpegdec_destroy(&(pool->decs[i]));
+            break;
+        }
+        pool->nworkers++;
+    }
+    if (pool->nworkers == 0)
+    {
+        fprintf(stderr, "%s: Could not start any workers\n", __func__);
+        jpegpool_destroy(pool);
+        return -1;
+    }
+    if (pool->nworkers < nworkers)
+        fprintf(stderr, "%s: Started %d of %d workers\n", __func__, pool->nworkers, nworkers);
+    return 1;
+}
+
+int jpegpool_submit(jpegpool *pool, jpegpool_job *job)
+{
+    pthread_mutex_lock(&(pool->lock));
+    if (pool->stop || pool->qlen >= pool->qcap)
+    {
+        pthread_mutex_unlock(&(pool->lock));
+        return -1;
+    }
+    job->seq = pool->seq++;
+    job->out = NULL;
+    job->status = 0;
+    jpegpool_push(pool, job);
+    pthread_cond_signal(&(pool->work));
+    pthread_mutex_unlock(&(pool->lock));
+    return 1;
+}
+
+void jpegpool_release(jpegpool_job *job)
+{
+    if (job->out == NULL)
+        return;
+    jpegpool *pool = JPEGPOOL_OF(job->out);
+    pthread_mutex_lock(&(pool->lock));
+    ucam_frame_unref(job->out);
+    job->out = NULL;
+    pthread_cond_broadcast(&(pool->work)); // a worker, or jpegpool_destroy, waits for it
+    pthread_mutex_unlock(&(pool->lock));
+}
+
+/**
+ * @brief Number of output buffers held by jobs.
+ *
+ */
+static int jpegpool_held(jpegpool *pool)
+{
+    pthread_mutex_lock(&(pool->bufs.lock));
+    int held = pool->bufs.nframes - pool->bufs.nfree;
+    pthread_mutex_unlock(&(pool->bufs.lock));
+    return held;
+}
+
+void jpegpool_wait(jpegpool *pool)
+{
+    pthread_mutex_lock(&(pool->lock));
+    while (pool->qlen > 0 || pool->busy > 0)
+        pthread_cond_wait(&(pool->idle), &(pool->lock));
+    pthread_mutex_unlock(&(pool->lock));
+}
+
+void jpegpool_destroy(jpegpool *pool)
+{
+    if (pool == NULL || pool->queue == NULL)
+        return;
+    pthread_mutex_lock(&(pool->lock));
+    pool->stop = 1;
+    pthread_cond_broadcast(&(pool->work));
+    pthread_mutex_unlock(&(pool->lock));
+    for (int i = 0; i < pool->nworkers; i++)
+    {
+        pthread_join(pool->threads[i], NULL);
+        jpegdec_destroy(&(pool->decs[i]));
+    }
+    // the buffers of completed jobs are still in use until they are released
+    pthread_mutex_lock(&(pool->lock));
+    while (pool->bufs.frames != NULL && jpegpool_held(pool) > 0)
+        pthread_cond_wait(&(pool->work), &(pool->lock));
+    pthread_mutex_unlock(&(pool->lock));
+    ucam_frame_pool_destroy(&(pool->bufs));
+    pthread_mutex_destroy(&(pool->lock));
+    pthread_cond_destroy(&(pool->work));
+    pthread_cond_destroy(&(pool->idle));
+    free(pool->queue);
+    memset(pool, 0x0, sizeof(jpegpool));
+}
@@ -0,0 +1,225 @@
+/**
+ * @file jpegstore.c
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Background storage of captured frames, rewritten to take less space.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <jpegstore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Write a buffer to a new file.
+ *
+ */
+static int jpegstore_write(const char *path, const unsigned char *data, size_t len)
+{
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "%s: Could not open %s\n", __func__, path);
+        return -1;
+    }
+    size_t n = fwrite(data, 1, len, fp);
+    if (fclose(fp) != 0 || n != len)
+    {
+        fprintf(stderr, "%s: Could not write %s\n", __func__, path);
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * @brief Write the table set of the last abbreviated frame unless it is among
+ * the ones written last.
+ *
+ */
+static int jpegstore_tables(jpegstore *store)
+{
+    unsigned int id = store->xc.tables_id;
+    int n = store->ntables < JPEGSTORE_MAX_TABLES ? store->ntables : JPEGSTORE_MAX_TABLES;
+    for (int i = 0; i < n; i++)
+        if (store->tables[i] == id)
+            return 0;
+    char path[JPEGSTORE_PATH_MAX];
+    snprintf(path, sizeof(path), "%s/tables_%08x.jpg", store->dir, id);
+    if (jpegstore_write(path, store->xc.tables, store->xc.tables_len) < 0)
+        return -1;
+    store->tables[store->ntables++ % JPEGSTORE_MAX_TABLES] = id;
+    return 1;
+}
+
+/**
+ * @brief Rewrite and write one frame, on the storage thread.
+ *
+ */
+static void jpegstore_frame(jpegstore *store, ucam_frame *frame)
+{
+    jpegstore_rec rec;
+    memset(&rec, 0x0, sizeof(jpegstore_rec));
+    rec.seq = frame->seq;
+    rec.rcvd = frame->len;
+    snprintf(rec.path, sizeof(rec.path), "%s/frame_%06llu.jpg", store->dir, frame->seq);
+    struct timespec start, end;
+    store->xc.progressive = __atomic_load_n(&(store->progressive), __ATOMIC_RELAXED);
+    store->xc.shared_tables = __atomic_load_n(&(store->shared_tables), __ATOMIC_RELAXED);
+    ucam_frame_stamp(&start);
+    rec.status = jpegxcode_optimize(&(store->xc), frame->data, frame->len);
+    ucam_frame_stamp(&end);
+    rec.us = ucam_frame_elapsed(&start, &end);
+    const unsigned char *data = store->xc.out;
+    size_t len = store->xc.out_len;
+    if (rec.status < 0) // keep the frame as it arrived, it may still be partly readable
+    {
+        data = frame->data;
+        len = frame->len > 0 ? frame->len : 0;
+        rec.len = len;
+    }
+    else
+        rec.len = store->xc.in_len;
+    if (rec.status > 0 && store->xc.shared_tables) // 0 kept the complete original
+    {
+        rec.shared = 1;
+        rec.tables_id = store->xc.tables_id;
+        if (jpegstore_tables(store) < 0) // the frame would not decode without them
+        {
+            rec.status = -1;
+            rec.shared = 0;
+            data = frame->data;
+            len = frame->len > 0 ? frame->len : 0;
+        }
+    }
+    int ret = jpegstore_write(rec.path, data, len);
+    rec.stored = ret > 0 ? len : 0;
+    if (ret < 0 && rec.status >= 0)
+        rec.status = -1;
+    ucam_frame_unref(frame);
+
+    pthread_mutex_lock(&(store->lock));
+    if (ret > 0)
+    {
+        store->nstored++;
+        store->bytes_in += rec.rcvd;
+        store->bytes_out += rec.stored;
+    }
+    if (rec.status < 0)
+        store->nerrors++;
+    pthread_mutex_unlock(&(store->lock));
+    if (store->done != NULL)
+        store->done(&rec, store->user);
+}
+
+static void *jpegstore_thread(void *arg)
+{
+    jpegstore *store = (jpegstore *)arg;
+    for (;;)
+    {
+        pthread_mutex_lock(&(store->lock));
+        while (store->qlen == 0 && !store->stop)
+            pthread_cond_wait(&(store->work), &(store->lock));
+        if (store->qlen == 0) // stopping and nothing left to do
+        {
+            pthread_mutex_unlock(&(store->lock));
+            break;
+        }
+        ucam_frame *frame = store->queue[store->qhead];
+        store->qhead = (store->qhead + 1) % store->qcap;
+        store->qlen--;
+        store->busy = 1;
+        pthread_mutex_unlock(&(store->lock));
+
+        jpegstore_frame(store, frame);
+
+        pthread_mutex_lock(&(store->lock));
+        store->busy = 0;
+        pthread_cond_broadcast(&(store->idle));
+        pthread_mutex_unlock(&(store->lock));
+    }
+    return NULL;
+}
+
+int jpegstore_init(jpegstore *store, const char *dir, int qcap, jpegstore_cb done, void *user)
+{
+    if (store == NULL || dir == NULL || qcap < 1)
+        return -1;
+    memset(store, 0x0, sizeof(jpegstore));
+    if (strlen(dir) >= sizeof(store->dir))
+    {
+        fprintf(stderr, "%s: Directory name too long\n", __func__);
+        return -1;
+    }
+    strcpy(store->dir, dir);
+    store->queue = (ucam_frame **)malloc(qcap * sizeof(ucam_frame *));
+    if (store->queue == NULL)
+        return -1;
+    store->qcap = qcap;
+    store->done = done;
+    store->user = user;
+    // the transcoder maps its own arenas, it is only used by the storage thread
+    if (jpegxcode_init(&(store->xc), NULL) < 0)
+    {
+        free(store->queue);
+        store->queue = NULL;
+        return -1;
+    }
+    pthread_mutex_init(&(store->lock), NULL);
+    pthread_cond_init(&(store->work), NULL);
+    pthread_cond_init(&(store->idle), NULL);
+    if (pthread_create(&(store->thread), NULL, jpegstore_thread, store) != 0)
+    {
+        fprintf(stderr, "%s: Could not start the storage thread\n", __func__);
+        jpegxcode_destroy(&(store->xc));
+        pthread_mutex_destroy(&(store->lock));
+        pthread_cond_destroy(&(store->work));
+        pthread_cond_destroy(&(store->idle));
+        free(store->queue);
+        store->queue = NULL;
+        return -1;
+    }
+    return 1;
+}
+
+int jpegstore_put(jpegstore *store, ucam_frame *frame)
+{
+    pthread_mutex_lock(&(store->lock));
+    if (store->stop || store->qlen >= store->qcap)
+    {
+        pthread_mutex_unlock(&(store->lock));
+        return -1;
+    }
+    store->queue[(store->qhead + store->qlen) % store->qcap] = ucam_frame_ref(frame);
+    store->qlen++;
+    pthread_cond_signal(&(store->work));
+    pthread_mutex_unlock(&(store->lock));
+    return 1;
+}
+
+void jpegstore_wait(jpegstore *store)
+{
+    pthread_mutex_lock(&(store->lock));
+    while (store->qlen > 0 || store->busy)
+        pthread_cond_wait(&(store->idle), &(store->lock));
+    pthread_mutex_unlock(&(store->lock));
+}
+
+void jpegstore_destroy(jpegstore *store)
+{
+    if (store == NULL || store->queue == NULL)
+        return;
+    pthread_mutex_lock(&(store->lock));
+    store->stop = 1;
+    pthread_cond_broadcast(&(store->work));
+    pthread_mutex_unlock(&(store->lock));
+    pthread_join(store->thread, NULL);
+    jpegxcode_destroy(&(store->xc));
+    pthread_mutex_destroy(&(store->lock));
+    pthread_cond_destroy(&(store->work));
+    pthread_cond_destroy(&(store->idle));
+    free(store->queue);
+    memset(store, 0x0, sizeof(jpegstore));
+}
@@ -0,0 +1,479 @@
+/**
+ * @file jpegxcode.c
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Rewrite captured JPEGs in the DCT coefficient domain, without decoding pixels.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <jpegxcode.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <math.h>
+#include <jerror.h>
+
+#define JPEGXCODE_SELF(cinfo) ((jpegxcode *)((char *)(cinfo) - offsetof(jpegxcode, cinfo)))
+
+/* Destination manager over out, which grows when an image does not fit. libjpeg
+ * stores a byte before it checks for space, so out is never handed over empty.
+ */
+static boolean jpegxcode_empty_output_buffer(j_compress_ptr cinfo);
+
+static void jpegxcode_init_destination(j_compress_ptr cinfo)
+{
+    jpegxcode *xc = JPEGXCODE_SELF(cinfo);
+    if (xc->out_sz == 0)
+        jpegxcode_empty_output_buffer(cinfo);
+    xc->dest.next_output_byte = xc->out;
+    xc->dest.free_in_buffer = xc->out_sz;
+    xc->out_len = 0;
+}
+
+static boolean jpegxcode_empty_output_buffer(j_compress_ptr cinfo)
+{
+    jpegxcode *xc = JPEGXCODE_SELF(cinfo);
+    size_t used = xc->out_sz;
+    size_t size = used < 4096 ? 4096 : 2 * used;
+    unsigned char *out = (unsigned char *)realloc(xc->out, size);
+    if (out == NULL)
+        ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 0);
+    xc->out = out;
+    xc->out_sz = size;
+    xc->dest.next_output_byte = out + used;
+    xc->dest.free_in_buffer = size - used;
+    return TRUE;
+}
+
+static void jpegxcode_term_destination(j_compress_ptr cinfo)
+{
+    jpegxcode *xc = JPEGXCODE_SELF(cinfo);
+    xc->out_len = xc->out_sz - xc->dest.free_in_buffer;
+}
+
+/**
+ * @brief Report the libjpeg error that was raised, count it and drop the image.
+ *
+ */
+static void jpegxcode_error(jpegxcode *xc)
+{
+    jpegdec_err_caught(&(xc->jerr), (j_common_ptr) & (xc->cinfo), &(xc->mem));
+    xc->nerrors++;
+    jpeg_abort_compress(&(xc->cinfo));
+}
+
+int jpegxcode_init(jpegxcode *xc, ucam_arena *arena)
+{
+    memset(xc, 0x0, sizeof(jpegxcode));
+    if (jpegcoef_init(&(xc->coef), arena) < 0)
+        return -1;
+    jpegdec_err_init(&(xc->jerr), (j_common_ptr) & (xc->cinfo));
+    if (setjmp(xc->jerr.env))
+    {
+        jpegxcode_error(xc);
+        jpeg_destroy_compress(&(xc->cinfo));
+        jpegcoef_destroy(&(xc->coef));
+        return -1;
+    }
+    jpeg_create_compress(&(xc->cinfo));
+    // the compress object reads the reader's virtual arrays, so both need the same memory manager
+    if (xc->coef.cinfo.mem != &(xc->coef.mem.pub) || jpegmem_init(&(xc->mem), arena, JPEGMEM_ARENA_SZ) <= 0)
+    {
+        fprintf(stderr, "%s: Coefficient transfer needs jpegmem on both sides\n", __func__);
+        jpeg_destroy_compress(&(xc->cinfo));
+        jpegcoef_destroy(&(xc->coef));
+        return -1;
+    }
+    jpegmem_attach(&(xc->mem), (j_common_ptr) & (xc->cinfo));
+    // jpeg_set_defaults only fills in Huffman tables that do not exist yet, so
+    // keep the standard ones before a frame is optimized
+    xc->cinfo.in_color_space = JCS_YCbCr;
+    xc->cinfo.input_components = 3;
+    jpeg_set_defaults(&(xc->cinfo));
+    for (int i = 0; i < 2; i++)
+    {
+        xc->std_dc[i] = *(xc->cinfo.dc_huff_tbl_ptrs[i]);
+        xc->std_ac[i] = *(xc->cinfo.ac_huff_tbl_ptrs[i]);
+    }
+    xc->dest.init_destination = jpegxcode_init_destination;
+    xc->dest.empty_output_buffer = jpegxcode_empty_output_buffer;
+    xc->dest.term_destination = jpegxcode_term_destination;
+    xc->cinfo.dest = &(xc->dest);
+    return 1;
+}
+
+/**
+ * @brief Go back to the standard Huffman tables for a frame that is not
+ * optimized.
+ *
+ */
+static void jpegxcode_std_huff(jpegxcode *xc)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        *(xc->cinfo.dc_huff_tbl_ptrs[i]) = xc->std_dc[i];
+        *(xc->cinfo.ac_huff_tbl_ptrs[i]) = xc->std_ac[i];
+    }
+}
+
+/**
+ * @brief Keep a copy of the coefficients that were read, so that every pass
+ * requantizes the original values.
+ *
+ */
+static int jpegxcode_save(jpegxcode *xc)
+{
+    struct jpeg_decompress_struct *src = &(xc->coef.cinfo);
+    size_t nblocks = 0;
+    for (int c = 0; c < src->num_components; c++)
+        nblocks += (size_t)src->comp_info[c].width_in_blocks * src->comp_info[c].height_in_blocks;
+    if (nblocks > xc->orig_sz)
+    {
+        JBLOCK *orig = (JBLOCK *)realloc(xc->orig, nblocks * sizeof(JBLOCK));
+        if (orig == NULL)
+            return -1;
+        xc->orig = orig;
+        xc->orig_sz = nblocks;
+    }
+    JBLOCK *blk = xc->orig;
+    for (int c = 0; c < src->num_components; c++)
+    {
+        jpeg_component_info *comp = &(src->comp_info[c]);
+        for (JDIMENSION y = 0; y < comp->height_in_blocks; y++)
+        {
+            JBLOCKROW row = (*src->mem->access_virt_barray)((j_common_ptr)src, xc->coef.coefs[c], y, 1, FALSE)[0];
+            memcpy(blk, row, comp->width_in_blocks * sizeof(JBLOCK));
+            blk += comp->width_in_blocks;
+        }
+    }
+    return 1;
+}
+
+/* Position in the block of every zig-zag index, the same as libjpeg's
+ * jpeg_natural_order, which jpeglib.h does not export.
+ */
+static const unsigned char jpegxcode_natural[DCTSIZE2] = {
+    0, 1, 8, 16, 9, 2, 3, 10,
+    17, 24, 32, 25, 18, 11, 4, 5,
+    12, 19, 26, 33, 40, 48, 41, 34,
+    27, 20, 13, 6, 7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46,
+    53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+/**
+ * @brief Write the saved coefficients requantized to scale percent of the
+ * original tables, keeping the first band coefficients of every block in
+ * zig-zag order and zeroing the rest.
+ *
+ */
+static void jpegxcode_write(jpegxcode *xc, int scale, int band)
+{
+    struct jpeg_decompress_struct *src = &(xc->coef.cinfo);
+    struct jpeg_compress_struct *dst = &(xc->cinfo);
+    jpeg_copy_critical_parameters(src, dst);
+    jpegxcode_std_huff(xc);
+    const JBLOCK *blk = xc->orig;
+    for (int c = 0; c < src->num_components; c++)
+    {
+        jpeg_component_info *comp = &(src->comp_info[c]);
+        const UINT16 *q = comp->quant_table->quantval;
+        UINT16 *nq = dst->quant_tbl_ptrs[dst->comp_info[c].quant_tbl_no]->quantval;
+        int num[DCTSIZE2], den[DCTSIZE2];
+        for (int k = 0; k < DCTSIZE2; k++)
+        {
+            long v = ((long)q[k] * scale + 50) / 100;
+            nq[k] = v < 1 ? 1 : (v > 255 ? 255 : v); // baseline tables
+            den[k] = nq[k];
+        }
+        for (int k = 0; k < DCTSIZE2; k++) // a coefficient out of the band dequantizes to 0
+            num[jpegxcode_natural[k]] = k < band ? q[jpegxcode_natural[k]] : 0;
+        for (JDIMENSION y = 0; y < comp->height_in_blocks; y++)
+        {
+            JBLOCKROW row = (*src->mem->access_virt_barray)((j_common_ptr)src, xc->coef.coefs[c], y, 1, TRUE)[0];
+            for (JDIMENSION x = 0; x < comp->width_in_blocks; x++, blk++)
+            {
+                for (int k = 0; k < DCTSIZE2; k++)
+                {
+                    int v = (*blk)[k] * num[k]; // dequantized
+                    row[x][k] = v >= 0 ? (v + den[k] / 2) / den[k] : -((-v + den[k] / 2) / den[k]);
+                }
+            }
+        }
+    }
+    jpeg_write_coefficients(dst, xc->coef.coefs);
+    jpeg_finish_compress(dst);
+    xc->scale = scale;
+    xc->band = band;
+    xc->npasses++;
+}
+
+/**
+ * @brief Swap the output with the best fit kept so far. After a pass that fits
+ * it keeps that pass and the next one writes into the buffer of the old fit; at
+ * the end it brings the best fit back.
+ *
+ */
+static void jpegxcode_swap(jpegxcode *xc)
+{
+    unsigned char *out = xc->out;
+    size_t out_sz = xc->out_sz, out_len = xc->out_len;
+    int scale = xc->scale, band = xc->band;
+    xc->out = xc->fit;
+    xc->out_sz = xc->fit_sz;
+    xc->out_len = xc->fit_len;
+    xc->scale = xc->fit_scale;
+    xc->band = xc->fit_band;
+    xc->fit = out;
+    xc->fit_sz = out_sz;
+    xc->fit_len = out_len;
+    xc->fit_scale = scale;
+    xc->fit_band = band;
+}
+
+/* Progressive scan scripts for small frames. All DC comes first, without
+ * successive approximation, so the first scan already gives a 1/8 scale image of
+ * the whole frame. The luminance AC is sent in two bands at half precision and
+ * refined in one last scan. Chroma goes in single full-precision scans, which is
+ * where libjpeg's standard script loses most on 160x128 frames.
+ */
+static const jpeg_scan_info jpegxcode_scans_color[] = {
+    {3, {0, 1, 2}, 0, 0, 0, 0},
+    {1, {0}, 1, 5, 0, 1},
+    {1, {2}, 1, 63, 0, 0},
+    {1, {1}, 1, 63, 0, 0},
+    {1, {0}, 6, 63, 0, 1},
+    {1, {0}, 1, 63, 1, 0},
+};
+
+static const jpeg_scan_info jpegxcode_scans_gray[] = {
+    {1, {0}, 0, 0, 0, 0},
+    {1, {0}, 1, 5, 0, 1},
+    {1, {0}, 6, 63, 0, 1},
+    {1, {0}, 1, 63, 1, 0},
+};
+
+/**
+ * @brief Make sure out holds at least size bytes.
+ *
+ */
+static int jpegxcode_reserve(jpegxcode *xc, size_t size)
+{
+    if (size <= xc->out_sz)
+        return 1;
+    unsigned char *out = (unsigned char *)realloc(xc->out, size);
+    if (out == NULL)
+        return -1;
+    xc->out = out;
+    xc->out_sz = size;
+    return 1;
+}
+
+int jpegxcode_fit(jpegxcode *xc, const unsigned char *jpg, size_t len, size_t target)
+{
+    xc->npasses = 0;
+    xc->in_len = len;
+    if (len <= target)
+    {
+        if (jpegxcode_reserve(xc, len) < 0)
+            return -1;
+        memcpy(xc->out, jpg, len);
+        xc->out_len = len;
+        xc->scale = 100;
+        xc->band = DCTSIZE2;
+        xc->nframes++;
+        return 1;
+    }
+    if (jpegcoef_read(&(xc->coef), jpg, len) < 0 || jpegxcode_save(xc) < 0)
+    {
+        jpegcoef_done(&(xc->coef));
+        return -1;
+    }
+    if (setjmp(xc->jerr.env))
+    {
+        jpegxcode_error(xc);
+        jpegcoef_done(&(xc->coef));
+        return -1;
+    }
+    int lo = 100, hi = JPEGXCODE_MAX_SCALE; // lo does not fit, hi is tried first
+    jpegxcode_write(xc, hi, DCTSIZE2);
+    int ret = xc->out_len <= target;
+    if (ret)
+        jpegxcode_swap(xc);
+    while (ret && xc->npasses < JPEGXCODE_MAX_PASSES && hi - lo > 1)
+    {
+        int mid = (int)sqrt((double)lo * hi); // size falls roughly with the log of the scale
+        jpegxcode_write(xc, mid, DCTSIZE2);
+        if (xc->out_len <= target)
+        {
+            hi = mid;
+            jpegxcode_swap(xc);
+        }
+        else
+            lo = mid;
+    }
+    if (!ret) // the coarsest tables do not fit, drop the highest frequencies as well
+    {
+        int fits = 0, over = DCTSIZE2; // a band of over coefficients does not fit, one of fits does (0 until one does)
+        while (xc->npasses < JPEGXCODE_MAX_PASSES && over - fits > 1)
+        {
+            int mid = (fits + over) / 2; // ends on DC alone if nothing wider fits
+            jpegxcode_write(xc, hi, mid);
+            if (xc->out_len <= target)
+            {
+                fits = mid;
+                jpegxcode_swap(xc);
+            }
+            else
+                over = mid;
+        }
+        ret = fits > 0;
+    }
+    if (ret) // the last pass may have overshot, bring the best fit back
+        jpegxcode_swap(xc);
+    jpegcoef_done(&(xc->coef));
+    xc->nframes++;
+    return ret;
+}
+
+/**
+ * @brief Write the quantization tables of the frame being rewritten as a
+ * tables-only datastream into xc->tables and name it by a hash of its bytes.
+ * The Huffman tables are left out, they are optimized for every frame.
+ *
+ */
+static int jpegxcode_write_tables(jpegxcode *xc)
+{
+    struct jpeg_compress_struct *dst = &(xc->cinfo);
+    for (int i = 0; i < NUM_HUFF_TBLS; i++)
+    {
+        if (dst->dc_huff_tbl_ptrs[i] != NULL)
+            dst->dc_huff_tbl_ptrs[i]->sent_table = TRUE;
+        if (dst->ac_huff_tbl_ptrs[i] != NULL)
+            dst->ac_huff_tbl_ptrs[i]->sent_table = TRUE;
+    }
+    jpeg_write_tables(dst); // through the destination manager into out
+    if (xc->out_len > xc->tables_sz)
+    {
+        unsigned char *tables = (unsigned char *)realloc(xc->tables, xc->out_len);
+        if (tables == NULL)
+            return -1;
+        xc->tables = tables;
+        xc->tables_sz = xc->out_len;
+    }
+    memcpy(xc->tables, xc->out, xc->out_len);
+    xc->tables_len = xc->out_len;
+    unsigned int id = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < xc->tables_len; i++)
+        id = (id ^ xc->tables[i]) * 16777619u;
+    xc->tables_id = id;
+    return 1;
+}
+
+int jpegxcode_tables_id(const unsigned char *jpg, size_t len, unsigned int *id)
+{
+    size_t taglen = sizeof(JPEGXCODE_TABLES_TAG);
+    size_t pos = 2;
+    if (len < 2 || jpg[0] != 0xFF || jpg[1] != 0xD8)
+        return -1;
+    // the marker comes before the frame header, stop at the first SOF or SOS
+    while (pos + 4 <= len && jpg[pos] == 0xFF && jpg[pos + 1] != 0xDA && (jpg[pos + 1] < 0xC0 || jpg[pos + 1] > 0xC2))
+    {
+        size_t seglen = (jpg[pos + 2] << 8) | jpg[pos + 3];
+        if (jpg[pos + 1] == JPEGXCODE_TABLES_MARKER && seglen == 2 + taglen + 4 && pos + 2 + seglen <= len &&
+            memcmp(&(jpg[pos + 4]), JPEGXCODE_TABLES_TAG, taglen) == 0)
+        {
+            const unsigned char *p = &(jpg[pos + 4 + taglen]);
+            *id = ((unsigned int)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+            return 1;
+        }
+        pos += 2 + seglen;
+    }
+    return 0;
+}
+
+int jpegxcode_optimize(jpegxcode *xc, const unsigned char *jpg, size_t len)
+{
+    struct jpeg_compress_struct *dst = &(xc->cinfo);
+    jpegcheck_info chk;
+    xc->npasses = 0;
+    if (jpegcheck_scan(jpg, len, 0, 0, &chk) <= 0)
+    {
+        fprintf(stderr, "%s: Not a complete JPEG: %s\n", __func__, chk.error != NULL ? chk.error : "no EOI");
+        return -1;
+    }
+    xc->in_len = chk.len; // drop the padding
+    if (jpegcoef_read(&(xc->coef), jpg, xc->in_len) < 0)
+        return -1;
+    if (setjmp(xc->jerr.env))
+    {
+        jpegxcode_error(xc);
+        jpegcoef_done(&(xc->coef));
+        return -1;
+    }
+    jpeg_copy_critical_parameters(&(xc->coef.cinfo), dst);
+    dst->optimize_coding = TRUE;
+    if (xc->progressive && dst->num_components == 3)
+    {
+        dst->scan_info = jpegxcode_scans_color;
+        dst->num_scans = sizeof(jpegxcode_scans_color) / sizeof(jpeg_scan_info);
+    }
+    else if (xc->progressive && dst->num_components == 1)
+    {
+        dst->scan_info = jpegxcode_scans_gray;
+        dst->num_scans = sizeof(jpegxcode_scans_gray) / sizeof(jpeg_scan_info);
+    }
+    else if (xc->progressive)
+        jpeg_simple_progression(dst);
+    if (xc->shared_tables && jpegxcode_write_tables(xc) < 0)
+    {
+        jpeg_abort_compress(dst);
+        jpegcoef_done(&(xc->coef));
+        return -1;
+    }
+    jpeg_write_coefficients(dst, xc->coef.coefs);
+    if (xc->shared_tables)
+    {
+        // frame headers are written by jpeg_finish_compress, after this
+        unsigned char tag[sizeof(JPEGXCODE_TABLES_TAG) + 4];
+        memcpy(tag, JPEGXCODE_TABLES_TAG, sizeof(JPEGXCODE_TABLES_TAG));
+        for (int i = 0; i < 4; i++)
+            tag[sizeof(JPEGXCODE_TABLES_TAG) + i] = xc->tables_id >> (24 - 8 * i);
+        jpeg_write_marker(dst, JPEGXCODE_TABLES_MARKER, tag, sizeof(tag));
+        for (int i = 0; i < NUM_QUANT_TBLS; i++)
+            if (dst->quant_tbl_ptrs[i] != NULL)
+                dst->quant_tbl_ptrs[i]->sent_table = TRUE;
+    }
+    jpeg_finish_compress(dst);
+    xc->scale = 100;
+    xc->band = DCTSIZE2;
+    xc->npasses++;
+    jpegcoef_done(&(xc->coef));
+    xc->nframes++;
+    // an abbreviated frame that is not smaller is not worth a table set
+    if (xc->out_len < xc->in_len || xc->progressive)
+        return 1;
+    if (jpegxcode_reserve(xc, xc->in_len) < 0)
+        return -1;
+    memcpy(xc->out, jpg, xc->in_len);
+    xc->out_len = xc->in_len;
+    return 0;
+}
+
+void jpegxcode_destroy(jpegxcode *xc)
+{
+    jpeg_destroy_compress(&(xc->cinfo));
+    jpegmem_destroy(&(xc->mem));
+    jpegcoef_destroy(&(xc->coef));
+    free(xc->out);
+    free(xc->fit);
+    free(xc->orig);
+    free(xc->tables);
+    memset(xc, 0x0, sizeof(jpegxcode));
+}
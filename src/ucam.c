@@ -19,6 +19,7 @@
 #include <errno.h>
 #include <string.h>
 #include <termios.h>
+#include <limits.h>
 #include <shserial/shserial.h>
 #include <gpiodev/gpiodev.h>
 
@@ -55,6 +56,23 @@ unsigned char ucam_baud_div2[] = {
     0x0,
 };
 
+unsigned int ucam_baud_rate[] = {
+    2400,
+    4800,
+    9600,
+    19200,
+    38400,
+    57600,
+    115200,
+    153600,
+    230400,
+    460800,
+    921600,
+    1228800,
+    1843200,
+    3686400,
+};
+
 static unsigned char UCAM_SYNC_CMD[] = {0xaa, UCAM_SYNC, 0x0, 0x0, 0x0, 0x0};
 static unsigned char UCAM_SYNC_ACK[] = {0xaa, UCAM_ACK, UCAM_SYNC, 0x0, 0x0, 0x0};
 
@@ -105,6 +123,7 @@ int ucam_init(ucam *dev, const char *fname, int baud, int rst)
     dev->rst = rst;
     dev->sync = 0;     // indicate lack of sync
     dev->pkg_sz = 512; // default package size
+    ucam_stats_init(&(dev->jpg_stats));
     if (rst > 0)
     {
         if (gpioSetMode(rst, GPIO_OUT) < 0)
@@ -329,11 +348,115 @@ int ucam_snap_picture(ucam *dev, ssize_t *len)
     return num_bytes;
 }
 
+static void ucam_frame_settings(ucam *dev, ucam_frame *frame)
+{
+    frame->img_fmt = dev->img_fmt;
+    frame->raw_res = dev->raw_res;
+    frame->jpg_res = dev->jpg_res;
+    frame->pic_mode = dev->pic_mode;
+    frame->contrast = dev->contrast;
+    frame->brightness = dev->brightness;
+    frame->exposure = dev->exposure;
+    frame->light = dev->light;
+    frame->pkg_sz = dev->pkg_sz;
+}
+
+int ucam_snap_frame(ucam *dev, ucam_frame *frame)
+{
+    ssize_t len = 0;
+    ucam_frame_settings(dev, frame);
+    ucam_frame_stamp(&(frame->t_snap));
+    int status = ucam_snap_picture(dev, &len);
+    if (status < 0)
+        return status;
+    if (len > (ssize_t)frame->cap)
+    {
+        fprintf(stderr, "%s: Image of %ld bytes does not fit in frame of %zu bytes\n", __func__, len, frame->cap);
+        return -1;
+    }
+    frame->len = len;
+    return len;
+}
+
+static int ucam_get_data_meta(ucam *dev, unsigned char *data, ssize_t len, unsigned char err_check, ucam_frame *frame, ucam_pkg_cb cb, void *user);
+
 int ucam_get_data(ucam *dev, unsigned char *data, ssize_t len, unsigned char err_check)
+{
+    return ucam_get_data_meta(dev, data, len, err_check, NULL, NULL, NULL);
+}
+
+int ucam_get_frame(ucam *dev, ucam_frame *frame, unsigned char err_check)
+{
+    return ucam_get_frame_stream(dev, frame, err_check, NULL, NULL);
+}
+
+int ucam_get_frame_stream(ucam *dev, ucam_frame *frame, unsigned char err_check, ucam_pkg_cb cb, void *user)
+{
+    int len = ucam_get_data_meta(dev, frame->data, frame->len, err_check, frame, cb, user);
+    if (len > 0 && frame->img_fmt == COL_JPEG)
+        ucam_stats_update(&(dev->jpg_stats), frame);
+    return len;
+}
+
+static ssize_t camera_read_full(int stream, unsigned char *buf, ssize_t len, int *retries);
+
+int ucam_get_raw_frame(ucam *dev, ucam_frame *frame)
+{
+    ucam_frame_settings(dev, frame);
+    frame->pic_mode = UCAM_RAW;
+    ucam_frame_stamp(&(frame->t_snap));
+    int status = ucam_cmd_with_ack(dev, UCAM_GET_PIC, UCAM_RAW, 0x0, 0x0, 0x0);
+    if (status < 0)
+    {
+        fprintf(stderr, "%s: Error getting a RAW picture\n", __func__);
+        return status;
+    }
+    // DATA: 0xaa 0x0a type, 24 bit image size
+    unsigned char inbuf[6];
+    if (camera_read_full(dev->fd, inbuf, 6, &(frame->retries)) != 6 || inbuf[0] != 0xaa || inbuf[1] != UCAM_DATA)
+    {
+        fprintf(stderr, "%s: No DATA for the RAW picture\n", __func__);
+        return -1;
+    }
+    ssize_t len = inbuf[3] | (inbuf[4] << 8) | (inbuf[5] << 16);
+    if (len > (ssize_t)frame->cap)
+    {
+        fprintf(stderr, "%s: Image of %ld bytes does not fit in frame of %zu bytes\n", __func__, len, frame->cap);
+        return -1;
+    }
+    ssize_t rcvd = camera_read_full(dev->fd, frame->data, len, &(frame->retries));
+    ucam_frame_stamp(&(frame->t_last));
+    frame->t_first = frame->t_snap; // RAW data arrives as one block right after DATA
+    frame->len = rcvd > 0 ? rcvd : 0;
+    // ucam_cmd_without_ack repeats the command, acknowledge once
+    unsigned char ack[] = {0xaa, UCAM_ACK, UCAM_DATA, 0x0, 0x1, 0x0};
+    if (write(dev->fd, ack, 6) != 6 || rcvd != len)
+        return -1;
+    return len;
+}
+
+size_t ucam_frame_size_hint(ucam *dev)
+{
+    return ucam_stats_bufsz(&(dev->jpg_stats), dev->jpg_res);
+}
+
+double ucam_estimate_xfer(ucam *dev, double *p99_ms)
+{
+    return ucam_stats_xfer_ms(&(dev->jpg_stats), dev->jpg_res, ucam_baud_rate[dev->baud], dev->pkg_sz, p99_ms);
+}
+
+static int ucam_get_data_meta(ucam *dev, unsigned char *data, ssize_t len, unsigned char err_check, ucam_frame *frame, ucam_pkg_cb cb, void *user)
 {
     // send the acknowledgement to start receiving data
     if (data == NULL)
         return -1;
+    ucam_frame meta; // transfer statistics are discarded if the caller has no frame
+    if (frame == NULL)
+    {
+        memset(&meta, 0x0, sizeof(ucam_frame));
+        frame = &meta;
+    }
+    frame->cksum = err_check ? UCAM_CKSUM_PASS : UCAM_CKSUM_NONE;
     int status = 0;
     int counter = 0;
     do
@@ -343,6 +466,7 @@ int ucam_get_data(ucam *dev, unsigned char *data, ssize_t len, unsigned char err
         if (status == 1)
             break;
     } while (counter < UCAM_MAX_TRIES_EXCEED);
+    frame->retries += counter - 1;
     // get the first packet
 
     if (dev->pic_mode == 0x0) // JPEG
@@ -364,6 +488,9 @@ int ucam_get_data(ucam *dev, unsigned char *data, ssize_t len, unsigned char err
                 tot += read(dev->fd, &tmpbuf[tot], 4 - tot);
                 fprintf(stderr, "%s %d: Received %d out of 4\n", __func__, __LINE__, tot);
             }
+            frame->retries += counter - 1;
+            if (frame->npkg == 0)
+                ucam_frame_stamp(&(frame->t_first));
 #ifdef UCAM_DEBUG
             fprintf(stderr, "%s, %d %d: 0x%02x 0x%02x 0x%02x 0x%02x\n", __func__, __LINE__, tot, tmpbuf[0], tmpbuf[1], tmpbuf[2], tmpbuf[3]);
 #endif
@@ -401,8 +528,16 @@ int ucam_get_data(ucam *dev, unsigned char *data, ssize_t len, unsigned char err
                 for (int i = 0; i < size; i++)
                     rcvd_ecc += data[rcvd + i];
                 fprintf(stderr, "%s: Received checksum = 0x%02x, Calculated checksum = 0x%02x, Checksum %s\n", __func__, ecc[0], rcvd_ecc, rcvd_ecc == ecc[0] ? "PASS" : "FAIL");
+                if (rcvd_ecc != (unsigned char)ecc[0])
+                {
+                    frame->cksum = UCAM_CKSUM_FAIL;
+                    frame->cksum_err++;
+                }
             }
             rcvd += size; // increment number of received bytes
+            frame->npkg++;
+            if (rcvd >= len)
+                ucam_frame_stamp(&(frame->t_last));
             // send ack
             usleep(50000);
             if (rcvd < len)
@@ -421,6 +556,8 @@ int ucam_get_data(ucam *dev, unsigned char *data, ssize_t len, unsigned char err
                 fprintf(stderr, "%s, %d: Sent ACK for package 0x%02x%02x\n", __func__, __LINE__, tmpbuf[1], tmpbuf[0]);
 #endif
             }
+            if (cb != NULL) // the camera is already sending the next package
+                cb(data, rcvd, len, user);
         }
         return len;
     }
@@ -433,6 +570,9 @@ int ucam_get_data(ucam *dev, unsigned char *data, ssize_t len, unsigned char err
                 usleep(100000); // give time for data to be available
             count = read(dev->fd, data, len);
         } while (count != len || counter < UCAM_CONFIG_MAX_RETRY);
+        ucam_frame_stamp(&(frame->t_last));
+        frame->t_first = frame->t_last; // RAW data arrives in a single read
+        frame->retries += counter - 1;
         if (counter >= UCAM_CONFIG_MAX_RETRY)
             return -UCAM_MAX_TRIES_EXCEED;
         if (ucam_cmd_without_ack(dev, UCAM_ACK, UCAM_DATA, 0x0, 0x1, 0x0) > 0)
@@ -522,37 +662,101 @@ static int ucam_cmd_without_ack(ucam *dev, unsigned char cmd, unsigned char p1,
     return 1;
 }
 
+static int camera_Jpg_meta(int stream, unsigned char *mem, ssize_t cap, unsigned short pkg_sz, int debug, ucam_frame *frame, ucam_pkg_cb cb, void *user);
+
 int camera_Jpg(int stream, unsigned char *mem, int debug)
 {
-    /* This function retrieves the JPEG from the camera. It is currently
-  setup for siz 512 byte packages, and may not work for smaller sizes.
-  Refer to USERGUIDE.md and the datasheet for further details.
+    return camera_Jpg_meta(stream, mem, SSIZE_MAX, 512, debug, NULL, NULL, NULL);
+}
+
+int camera_Jpg_frame(ucam *dev, ucam_frame *frame, int debug)
+{
+    return camera_Jpg_stream(dev, frame, NULL, NULL, debug);
+}
+
+int camera_Jpg_stream(ucam *dev, ucam_frame *frame, ucam_pkg_cb cb, void *user, int debug)
+{
+    ucam_frame_settings(dev, frame);
+    int len = camera_Jpg_meta(dev->fd, frame->data, frame->cap, dev->pkg_sz, debug, frame, cb, user);
+    frame->len = len > 0 ? len : 0;
+    if (len > 0)
+        ucam_stats_update(&(dev->jpg_stats), frame);
+    return len;
+}
+
+/**
+ * @brief Read exactly len bytes from the (non-blocking) serial stream, waiting
+ * for more data when a read comes back empty.
+ * 
+ * @return ssize_t len on success, bytes read so far if the camera went silent, negative on error
+ */
+static ssize_t camera_read_full(int stream, unsigned char *buf, ssize_t len, int *retries)
+{
+    ssize_t tot = 0;
+    int counter = 0;
+    while (tot < len && counter < UCAM_CONFIG_MAX_RETRY)
+    {
+        ssize_t count = read(stream, &(buf[tot]), len - tot);
+        if (count > 0)
+        {
+            tot += count;
+            continue;
+        }
+        if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            return -1;
+        counter++;
+        (*retries)++;
+        usleep((len - tot) * 100); // ~87 us per byte at 115200 baud
+    }
+    return tot;
+}
+
+static int camera_Jpg_meta(int stream, unsigned char *mem, ssize_t cap, unsigned short pkg_sz, int debug, ucam_frame *frame, ucam_pkg_cb cb, void *user)
+{
+    /* This function retrieves the JPEG from the camera. The payload of every
+  package is read straight into its final offset in mem using the size field
+  of the package header, so any package size from 64 to 512 bytes works and
+  the end of the JPEG is exact. Refer to USERGUIDE.md and the datasheet for
+  further details.
   */
-    char _GET[] = {0xAA, 0x04, 0x05, 0x00, 0x00, 0x00};
-    char _GET_ACK[] = {0x0AA, 0x0E, 0x04, 0x00, 0x00, 0x00};
-    char _DATA[] = {0xAA, 0x0A, 0x05, 0x00, 0x00, 0x00};
-    char _DACK[] = {0xAA, 0x0E, 0x00, 0x00, 0x00, 0x00};
-    char received[512];
-    char inbuff[6];
+    unsigned char _GET[] = {0xAA, 0x04, 0x05, 0x00, 0x00, 0x00};
+    unsigned char _GET_ACK[] = {0x0AA, 0x0E, 0x04, 0x00, 0x00, 0x00};
+    unsigned char _DATA[] = {0xAA, 0x0A, 0x05, 0x00, 0x00, 0x00};
+    unsigned char _DACK[] = {0xAA, 0x0E, 0x00, 0x00, 0x00, 0x00};
+    unsigned char inbuff[6];
+    unsigned char pkg_hdr[4]; // package ID, payload size
+    unsigned char verify[2];  // verify code
     int count;
-    int pcknum = 1;
     int size = 0;
     int temp = 0;
+    ucam_frame meta; // transfer statistics are discarded if the caller has no frame
+    if (frame == NULL)
+    {
+        memset(&meta, 0x0, sizeof(ucam_frame));
+        frame = &meta;
+    }
+    if (pkg_sz < 64 || pkg_sz > 512)
+    {
+        if (debug)
+            printf("Package size %d out of range (64 -- 512)\n", pkg_sz);
+        return -1;
+    }
 
+    ucam_frame_stamp(&(frame->t_snap));
     count = write(stream, _GET, 6);
     if (count < 0)
     {
         if (debug)
-            printf("###### WRITE STREAM ERROR ######\nEXITING\n");
-        exit(1);
+            printf("###### WRITE STREAM ERROR ######\n");
+        return -1;
     }
     usleep(80000);
     count = read(stream, (void *)inbuff, 6);
     if (count < 0)
     {
         if (debug)
-            printf("###### READ ERROR ######\nEXITING\n");
-        exit(1);
+            printf("###### READ ERROR ######\n");
+        return -1;
     }
     if (debug)
     {
@@ -576,8 +780,8 @@ int camera_Jpg(int stream, unsigned char *mem, int debug)
         if (count < 0)
         {
             if (debug)
-                printf("###### READ ERROR ######\nEXITING\n");
-            exit(1);
+                printf("###### READ ERROR ######\n");
+            return -1;
         }
         if (inbuff[0] == _DATA[0] && inbuff[1] == _DATA[1] && inbuff[2] == _DATA[2])
         {
@@ -591,68 +795,78 @@ int camera_Jpg(int stream, unsigned char *mem, int debug)
             size += temp;
             if (debug)
                 printf("size = %d\n", size); //FILESIZE in bytes
-            count = write(stream, _DACK, 6);
-            if (count < 0)
+            if (size > cap)
             {
                 if (debug)
-                    printf("###### WRITE FILE ERROR ######\nEXITING\n");
-                exit(1);
+                    printf("Image of %d bytes does not fit in buffer of %ld bytes\n", size, (long)cap);
+                return -1;
             }
-            usleep(50000);
-            count = read(stream, (void *)received, 512);
+            count = write(stream, _DACK, 6);
             if (count < 0)
             {
                 if (debug)
-                    printf("###### READ ERROR ######\nEXITING\n");
-                exit(1);
+                    printf("###### WRITE FILE ERROR ######\n");
+                return -1;
             }
-            temp = received[3];
-            size = received[4];
-            temp *= 256;
-            size += temp;
-            _DACK[4] = received[0];
-            _DACK[5] = received[1];
-            int ii = 0;
-            int tot = 0;
-            while (pcknum != 0)
+            frame->cksum = UCAM_CKSUM_PASS;
+            int rcvd = 0;
+            while (rcvd < size)
             {
-                char tempr[506];
-                int j = 0;
-                for (int k = 4; k < 510; k++)
+                if (camera_read_full(stream, pkg_hdr, 4, &(frame->retries)) != 4)
                 {
-                    tempr[j] = received[k];
-                    j++;
+                    if (debug)
+                        printf("Package header timed out after %d of %d bytes\n", rcvd, size);
+                    return -1;
                 }
-                memcpy(&(mem[ii]), tempr, 506);
-                ii += 506;
-                if (write(stream, _DACK, 6) < 0)
+                if (pkg_hdr[0] == 0xAA && pkg_hdr[1] == UCAM_NAC)
+                {
+                    if (debug)
+                        printf("NAC received after %d of %d bytes\n", rcvd, size);
+                    return -1;
+                }
+                int payload = pkg_hdr[2] | (pkg_hdr[3] << 8);
+                if (payload == 0 || payload > pkg_sz - 6 || payload > size - rcvd)
                 {
                     if (debug)
-                        printf("Failed to Write.");
-                    exit(1);
+                        printf("Invalid payload size %d in package 0x%02x%02x\n", payload, pkg_hdr[1], pkg_hdr[0]);
+                    return -1;
                 }
-                usleep(50000);
-                count = read(stream, (void *)received, 512);
-                _DACK[4] = received[0];
-                _DACK[5] = received[1];
-                if (debug)
-                    printf("pckgsize = %d\n", count);
-                pcknum = count;
-                tot += pcknum;
-                if (count < 0)
+                if (frame->npkg == 0)
+                    ucam_frame_stamp(&(frame->t_first));
+                if (camera_read_full(stream, &(mem[rcvd]), payload, &(frame->retries)) != payload ||
+                    camera_read_full(stream, verify, 2, &(frame->retries)) != 2)
                 {
                     if (debug)
-                        printf("###### READ ERROR ######\nEXITING\n");
-                    exit(1);
+                        printf("Package 0x%02x%02x timed out\n", pkg_hdr[1], pkg_hdr[0]);
+                    return -1;
+                }
+                unsigned char cksum = pkg_hdr[0] + pkg_hdr[1] + pkg_hdr[2] + pkg_hdr[3];
+                for (int i = 0; i < payload; i++)
+                    cksum += mem[rcvd + i];
+                if (cksum != verify[0])
+                {
+                    frame->cksum = UCAM_CKSUM_FAIL;
+                    frame->cksum_err++;
                 }
-            }
-            if (write(stream, _DACK, 6) < 0)
-            {
                 if (debug)
-                    printf("Failed to Write.");
-                exit(1);
+                    printf("package 0x%02x%02x: %d bytes, checksum %s\n", pkg_hdr[1], pkg_hdr[0], payload, cksum == verify[0] ? "PASS" : "FAIL");
+                rcvd += payload;
+                frame->npkg++;
+                // request the next package, or end the transfer
+                _DACK[4] = rcvd < size ? pkg_hdr[0] : 0xF0;
+                _DACK[5] = rcvd < size ? pkg_hdr[1] : 0xF0;
+                if (write(stream, _DACK, 6) < 0)
+                {
+                    if (debug)
+                        printf("Failed to Write.\n");
+                    return -1;
+                }
+                if (rcvd >= size)
+                    ucam_frame_stamp(&(frame->t_last));
+                if (cb != NULL) // the camera is already sending the next package
+                    cb(mem, rcvd, size, user);
             }
-            return tot;
+            return rcvd;
         }
     }
     if (debug)
@@ -662,9 +876,18 @@ int camera_Jpg(int stream, unsigned char *mem, int debug)
 
 #ifdef UNIT_TEST
 #include <stdlib.h>
-int main()
+#include <ucam_arena.h>
+int main(int argc, char *argv[])
 {
     ucam dev;
+    ucam_arena arena;
+    ucam_frame_pool pool;
+    int nframes = argc > 1 ? atoi(argv[1]) : 1; // number of frames to capture
+    if (ucam_arena_init(&arena, 1024 * 1024, UCAM_ARENA_ALL) < 0) // enough for a 640x480 RGB565 frame
+    {
+        printf("Failed to set up arena, exiting\n");
+        return -1;
+    }
     if (ucam_init(&dev, "/dev/ttyS0", B115200, 11) < 0)
     {
         printf("Failed to init, exiting\n");
@@ -683,17 +906,47 @@ int main()
     }
     ucam_config(&dev, UCAM_INIT);
     ucam_config(&dev, UCAM_SET_PACK_SZ);
-    ssize_t len = 0;
-    len = ucam_snap_picture(&dev, &len);
-    fprintf(stderr, "snapped picture: length %ld, ", len);
-    if (len > 0)
+    size_t mark = ucam_arena_mark(&arena);
+    if (ucam_frame_pool_init(&pool, 1, ucam_frame_size_hint(&dev), &arena) < 0)
+    {
+        printf("Failed to set up frame pool, exiting\n");
+        return -1;
+    }
+    for (int i = 0; i < nframes; i++)
     {
-        unsigned char *img_data = (unsigned char *)malloc(len);
-        ucam_get_data(&dev, img_data, len, 1);
-        fprintf(stderr, "got data, ");
-        free(img_data);
+        // grow the pool if the frames seen so far predict that the buffer is too small
+        if (ucam_frame_size_hint(&dev) > pool.cap)
+        {
+            ucam_frame_pool_destroy(&pool);
+            ucam_arena_rewind(&arena, mark);
+            if (ucam_frame_pool_init(&pool, 1, ucam_frame_size_hint(&dev), &arena) < 0)
+            {
+                printf("Failed to resize frame pool, exiting\n");
+                return -1;
+            }
+        }
+        double p99_ms = 0;
+        double mean_ms = ucam_estimate_xfer(&dev, &p99_ms);
+        fprintf(stderr, "frame %d: expecting %.0f ms (p99 %.0f ms) into a %zu byte buffer, ", i, mean_ms, p99_ms, pool.cap);
+        ucam_frame *frame = ucam_frame_get(&pool);
+        ssize_t len = ucam_snap_frame(&dev, frame);
+        fprintf(stderr, "snapped picture: length %ld, ", len);
+        if (len > 0)
+        {
+            ucam_pgfault flt_start, flt;
+            ucam_pgfault_sample(&flt_start);
+            ucam_get_frame(&dev, frame, 1);
+            ucam_pgfault_since(&flt_start, &flt);
+            fprintf(stderr, "got data (%ld minor, %ld major page faults during transfer), ", flt.minflt, flt.majflt);
+        }
+        fprintf(stderr, "\n");
+        ucam_frame_print(frame, stderr);
+        ucam_frame_unref(frame);
     }
-    fprintf(stderr, "\n");
+    ucam_stats_print(&(dev.jpg_stats), stderr);
+    ucam_frame_pool_destroy(&pool);
+    ucam_arena_report(&arena, stderr);
+    ucam_arena_destroy(&arena);
     ucam_destroy(&dev);
     printf("%s: Destroyed ucam\n", __func__);
     return 0;
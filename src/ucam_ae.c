@@ -0,0 +1,91 @@
+/**
+ * @file ucam_ae.c
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Closed-loop auto-exposure over the contrast, brightness and exposure settings.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <ucam_ae.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+void ucam_ae_init(ucam_ae *ae, unsigned char contrast, unsigned char brightness, unsigned char exposure)
+{
+    memset(ae, 0x0, sizeof(ucam_ae));
+    ae->target = UCAM_AE_TARGET;
+    ae->deadband = UCAM_AE_DEADBAND;
+    ae->gain = UCAM_AE_GAIN;
+    ae->contrast = contrast > 4 ? 4 : contrast;
+    int level = (brightness > 4 ? 4 : brightness) + (exposure > 4 ? 4 : exposure);
+    ae->level = level;
+    ucam_ae_settings(level, &(ae->brightness), &(ae->exposure));
+}
+
+void ucam_ae_settings(int level, unsigned char *brightness, unsigned char *exposure)
+{
+    if (level < 0)
+        level = 0;
+    if (level > UCAM_AE_NLEVELS - 1)
+        level = UCAM_AE_NLEVELS - 1;
+    int e = level - 2;
+    e = e < 0 ? 0 : (e > 4 ? 4 : e);
+    *exposure = e;
+    *brightness = level - e;
+}
+
+int ucam_ae_update(ucam_ae *ae, const ucam_frame *frame)
+{
+    const ucam_luma *luma = &(frame->luma);
+    if (luma->nblocks == 0 || frame->contrast != ae->contrast || frame->brightness != ae->brightness || frame->exposure != ae->exposure)
+    {
+        ae->nskipped++;
+        return -1;
+    }
+    ae->nframes++;
+    float mean = luma->mean < 1 ? 1 : luma->mean;
+    float err = log2f(ae->target / mean);
+    // a bright sky or a dark limb can leave the mean on target; highlights or
+    // shadows lost on one side still cost a step, unless both are lost
+    int clipped = luma->clipped > UCAM_AE_CLIP, crushed = luma->crushed > UCAM_AE_CLIP;
+    if (clipped && !crushed && err > -UCAM_AE_STEP_EV)
+        err = -UCAM_AE_STEP_EV;
+    else if (crushed && !clipped && err < UCAM_AE_STEP_EV)
+        err = UCAM_AE_STEP_EV;
+    ae->err = err;
+    if (fabsf(err) >= ae->deadband)
+    {
+        ae->level += ae->gain * err / UCAM_AE_STEP_EV;
+        if (ae->level < 0) // no wind-up against the ends of the range
+            ae->level = 0;
+        if (ae->level > UCAM_AE_NLEVELS - 1)
+            ae->level = UCAM_AE_NLEVELS - 1;
+    }
+    unsigned char brightness, exposure, contrast = ae->contrast;
+    ucam_ae_settings(lroundf(ae->level), &brightness, &exposure);
+    if (brightness == ae->brightness && exposure == ae->exposure)
+    {
+        // with the exposure settled, fit a scene wider than the sensor's range
+        // by lowering the contrast, and go back to nominal once it fits again
+        if (luma->clipped >= UCAM_AE_WIDE && luma->crushed >= UCAM_AE_WIDE && contrast > 0)
+            contrast--;
+        else if (luma->clipped < UCAM_AE_NARROW && luma->crushed < UCAM_AE_NARROW && contrast < 2)
+            contrast++;
+    }
+    if (brightness == ae->brightness && exposure == ae->exposure && contrast == ae->contrast)
+        return 0;
+    ae->brightness = brightness;
+    ae->exposure = exposure;
+    ae->contrast = contrast;
+    ae->nchanges++;
+    return 1;
+}
+
+void ucam_ae_print(const ucam_ae *ae, FILE *fp)
+{
+    fprintf(fp, "AE: C/B/E %d/%d/%d, level %.2f, error %+.2f stops, %lu frames used, %lu skipped, %lu changes\n",
+            ae->contrast, ae->brightness, ae->exposure, ae->level, ae->err, ae->nframes, ae->nskipped, ae->nchanges);
+}
@@ -0,0 +1,194 @@
+/**
+ * @file ucam_arena.c
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Locked, pre-faulted memory arena for capture and decode buffers.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#define _GNU_SOURCE // RUSAGE_THREAD, MADV_HUGEPAGE
+#include <ucam_arena.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#define UCAM_ARENA_HPAGE_DEFAULT (2 * 1024 * 1024) // PMD size on arm and x86
+
+static size_t ucam_arena_hpage_size(void)
+{
+    size_t hpage = UCAM_ARENA_HPAGE_DEFAULT;
+    FILE *fp = fopen("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r");
+    if (fp != NULL)
+    {
+        unsigned long val = 0;
+        if (fscanf(fp, "%lu", &val) == 1 && val > 0)
+            hpage = val;
+        fclose(fp);
+    }
+    return hpage;
+}
+
+static inline size_t ucam_arena_align(size_t val, size_t align)
+{
+    return (val + align - 1) & ~(align - 1);
+}
+
+int ucam_arena_init(ucam_arena *arena, size_t size, int flags)
+{
+    if (arena == NULL || size == 0)
+        return -1;
+    memset(arena, 0x0, sizeof(ucam_arena));
+    arena->flags = flags;
+
+    ucam_pgfault start;
+    ucam_pgfault_sample(&start);
+
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t align = page;
+#ifdef MADV_HUGEPAGE
+    if (flags & UCAM_ARENA_HUGEPAGE)
+        align = ucam_arena_hpage_size();
+#endif
+    size = ucam_arena_align(size, align);
+    // over-allocate so that the start can be moved to a huge page boundary
+    size_t map_size = size + (align > page ? align : 0);
+    unsigned char *map = (unsigned char *)mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED)
+    {
+        fprintf(stderr, "%s: Could not map %zu bytes: %s\n", __func__, map_size, strerror(errno));
+        return -1;
+    }
+    unsigned char *base = (unsigned char *)ucam_arena_align((uintptr_t)map, align);
+    // give back the unaligned head and the unused tail
+    if (base > map)
+        munmap(map, base - map);
+    if ((base + size) < (map + map_size))
+        munmap(base + size, (map + map_size) - (base + size));
+    arena->map = base;
+    arena->map_size = size;
+    arena->base = base;
+    arena->size = size;
+
+#ifdef MADV_HUGEPAGE
+    if (flags & UCAM_ARENA_HUGEPAGE)
+    {
+        if (madvise(base, size, MADV_HUGEPAGE) == 0)
+            arena->huge = 1;
+        else
+            fprintf(stderr, "%s: Transparent huge pages unavailable: %s\n", __func__, strerror(errno));
+    }
+#endif
+    if (flags & UCAM_ARENA_PREFAULT)
+    {
+        // write to every page so that it is backed by real memory, not the zero page
+        for (size_t ofst = 0; ofst < size; ofst += page)
+            ((volatile unsigned char *)base)[ofst] = 0x0;
+    }
+    if (flags & UCAM_ARENA_LOCK)
+    {
+        if (mlock(base, size) == 0)
+            arena->locked = 1;
+        else
+            fprintf(stderr, "%s: Could not lock %zu bytes (%s), continuing unlocked\n", __func__, size, strerror(errno));
+    }
+    ucam_pgfault_since(&start, &(arena->flt_init));
+#ifdef UCAM_DEBUG
+    ucam_arena_report(arena, stderr);
+#endif
+    return 1;
+}
+
+int ucam_arena_sub(ucam_arena *parent, ucam_arena *child, size_t size)
+{
+    if (parent == NULL || child == NULL)
+        return -1;
+    unsigned char *base = (unsigned char *)ucam_arena_alloc(parent, size);
+    if (base == NULL)
+    {
+        fprintf(stderr, "%s: Parent arena exhausted, requested %zu bytes, %zu available\n", __func__, size, parent->size - parent->used);
+        return -1;
+    }
+    memset(child, 0x0, sizeof(ucam_arena));
+    child->base = base;
+    child->size = ucam_arena_align(size, UCAM_ARENA_ALIGN);
+    child->flags = parent->flags;
+    child->locked = parent->locked;
+    child->huge = parent->huge;
+    return 1;
+}
+
+void *ucam_arena_alloc(ucam_arena *arena, size_t size)
+{
+    size_t ofst = ucam_arena_align(arena->used, UCAM_ARENA_ALIGN);
+    if (size > arena->size || ofst > arena->size - size)
+        return NULL;
+    arena->used = ofst + size;
+    if (arena->used > arena->peak)
+        arena->peak = arena->used;
+    return arena->base + ofst;
+}
+
+size_t ucam_arena_mark(ucam_arena *arena)
+{
+    return arena->used;
+}
+
+void ucam_arena_rewind(ucam_arena *arena, size_t mark)
+{
+    if (mark < arena->used)
+        arena->used = mark;
+}
+
+void ucam_arena_reset(ucam_arena *arena)
+{
+    arena->used = 0;
+}
+
+void ucam_arena_destroy(ucam_arena *arena)
+{
+    if (arena == NULL)
+        return;
+    if (arena->map != NULL)
+    {
+        if (arena->locked)
+            munlock(arena->map, arena->map_size);
+        munmap(arena->map, arena->map_size);
+    }
+    memset(arena, 0x0, sizeof(ucam_arena));
+}
+
+void ucam_arena_report(ucam_arena *arena, FILE *fp)
+{
+    fprintf(fp, "Arena %p: %zu of %zu bytes used (peak %zu), %s, %s, %ld minor + %ld major faults at init\n",
+            arena->base, arena->used, arena->size, arena->peak,
+            arena->locked ? "locked" : "not locked",
+            arena->huge ? "huge pages" : "normal pages",
+            arena->flt_init.minflt, arena->flt_init.majflt);
+}
+
+void ucam_pgfault_sample(ucam_pgfault *flt)
+{
+    struct rusage usage;
+#ifdef RUSAGE_THREAD
+    if (getrusage(RUSAGE_THREAD, &usage) < 0)
+#endif
+        getrusage(RUSAGE_SELF, &usage);
+    flt->minflt = usage.ru_minflt;
+    flt->majflt = usage.ru_majflt;
+}
+
+void ucam_pgfault_since(const ucam_pgfault *start, ucam_pgfault *delta)
+{
+    ucam_pgfault now;
+    ucam_pgfault_sample(&now);
+    delta->minflt = now.minflt - start->minflt;
+    delta->majflt = now.majflt - start->majflt;
+}
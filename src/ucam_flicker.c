@@ -0,0 +1,133 @@
+/**
+ * @file ucam_flicker.c
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Detection of 50/60 Hz light flicker from row banding in low resolution frames.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <ucam_flicker.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+void ucam_flicker_init(ucam_flicker *fl, unsigned char light)
+{
+    memset(fl, 0x0, sizeof(ucam_flicker));
+    fl->line_us = UCAM_FLICKER_LINE_US;
+    fl->light = light & 0x1;
+    fl->detected = -1;
+}
+
+/**
+ * @brief Least-squares fit of a sinusoid with the given period (in rows), with
+ * free amplitude, phase and offset, to the samples r taken at rows pos.
+ *
+ * @return float Share of the variance of r the fit explains (0--1)
+ */
+static float ucam_flicker_fit(const float *r, const int *pos, int n, float period)
+{
+    // r has zero mean; center the basis too, which fits the offset
+    float c[UCAM_FLICKER_MAX_ROWS], s[UCAM_FLICKER_MAX_ROWS];
+    float cm = 0, sm = 0;
+    for (int y = 0; y < n; y++)
+    {
+        float w = 2 * (float)M_PI * pos[y] / period;
+        c[y] = cosf(w);
+        s[y] = sinf(w);
+        cm += c[y];
+        sm += s[y];
+    }
+    cm /= n;
+    sm /= n;
+    float cc = 0, ss = 0, cs = 0, cr = 0, sr = 0, rr = 0;
+    for (int y = 0; y < n; y++)
+    {
+        float cy = c[y] - cm, sy = s[y] - sm;
+        cc += cy * cy;
+        ss += sy * sy;
+        cs += cy * sy;
+        cr += cy * r[y];
+        sr += sy * r[y];
+        rr += r[y] * r[y];
+    }
+    float det = cc * ss - cs * cs;
+    if (det <= 1e-6f * cc * ss || rr <= 0)
+        return 0;
+    float a = (cr * ss - sr * cs) / det;
+    float b = (sr * cc - cr * cs) / det;
+    return (a * cr + b * sr) / rr;
+}
+
+int ucam_flicker_update(ucam_flicker *fl, const unsigned char *pix, int width, int height, int stride, float lines_per_row, unsigned char light)
+{
+    if (height > UCAM_FLICKER_MAX_ROWS || height < 4 || width < 1 || lines_per_row <= 0)
+        return -1;
+    float rows[UCAM_FLICKER_MAX_ROWS];
+    for (int y = 0; y < height; y++)
+    {
+        const unsigned char *p = &(pix[(size_t)y * stride]);
+        unsigned int sum = 0;
+        for (int x = 0; x < width; x++)
+            sum += p[x];
+        rows[y] = (float)sum / width;
+    }
+    // frames taken before the last change still show the old banding, and only
+    // two frames taken with the same setting show how the bands moved
+    light &= 0x1;
+    int have_prev = fl->nrows == height && fl->prev_light == light;
+    float prev[UCAM_FLICKER_MAX_ROWS];
+    memcpy(prev, fl->prev, height * sizeof(float));
+    memcpy(fl->prev, rows, height * sizeof(float));
+    fl->nrows = height;
+    fl->prev_light = light;
+    if (!have_prev || light != fl->light)
+        return -1;
+    // relative change of every row, the scene cancels and the moving bands stay
+    float r[UCAM_FLICKER_MAX_ROWS], mean = 0;
+    int pos[UCAM_FLICKER_MAX_ROWS], n = 0;
+    for (int y = 0; y < height; y++)
+    {
+        if (rows[y] < 8 || prev[y] < 8 || rows[y] > 247 || prev[y] > 247) // no banding in black or clipped rows
+            continue;
+        r[n] = rows[y] / prev[y];
+        pos[n] = y;
+        mean += r[n++];
+    }
+    if (n < height / 2)
+        return -1;
+    mean /= n;
+    for (int y = 0; y < n; y++)
+        r[y] -= mean;
+    fl->nframes++;
+    for (int l = 0; l < 2; l++)
+    {
+        float hz = l ? 120 : 100; // twice the mains frequency
+        fl->fit[l] = ucam_flicker_fit(r, pos, n, 1e6f / hz / (fl->line_us * lines_per_row));
+    }
+    int best = fl->fit[1] > fl->fit[0];
+    int seen = -1;
+    if (fl->fit[best] >= UCAM_FLICKER_MIN_FIT && fl->fit[best] >= UCAM_FLICKER_MARGIN * fl->fit[!best])
+        seen = best;
+    if (seen < 0 || seen != fl->detected)
+    {
+        fl->detected = seen;
+        fl->votes = seen < 0 ? 0 : 1;
+        return 0;
+    }
+    if (++fl->votes < UCAM_FLICKER_VOTES || seen == fl->light)
+        return 0;
+    fl->light = seen;
+    fl->votes = 0;
+    fl->detected = -1;
+    fl->nchanges++;
+    return 1;
+}
+
+void ucam_flicker_print(const ucam_flicker *fl, FILE *fp)
+{
+    fprintf(fp, "Flicker: light %d (%d Hz), fit 100 Hz %.2f 120 Hz %.2f, %lu frames compared, %lu changes\n",
+            fl->light, fl->light ? 60 : 50, fl->fit[0], fl->fit[1], fl->nframes, fl->nchanges);
+}
@@ -0,0 +1,190 @@
+/**
+ * @file ucam_frame.c
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Reference-counted frame descriptors carrying capture metadata.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <ucam_frame.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UCAM_FRAME_NRAW 4
+
+static const unsigned char ucam_frame_raw_res[UCAM_FRAME_NRAW] = {0x1, 0x3, 0x9, 0xb}; // ucam_raw_res
+static const int ucam_frame_raw_width[UCAM_FRAME_NRAW] = {80, 160, 128, 128};
+static const int ucam_frame_raw_height[UCAM_FRAME_NRAW] = {60, 120, 128, 96};
+
+int ucam_frame_pool_init(ucam_frame_pool *pool, int nframes, size_t cap, ucam_arena *arena)
+{
+    if (pool == NULL || nframes < 1 || cap == 0)
+        return -1;
+    memset(pool, 0x0, sizeof(ucam_frame_pool));
+    if (arena != NULL)
+    {
+        size_t mark = ucam_arena_mark(arena);
+        pool->frames = (ucam_frame *)ucam_arena_alloc(arena, nframes * sizeof(ucam_frame));
+        for (int i = 0; pool->frames != NULL && i < nframes; i++)
+        {
+            pool->frames[i].data = (unsigned char *)ucam_arena_alloc(arena, cap);
+            if (pool->frames[i].data == NULL)
+                pool->frames = NULL;
+        }
+        if (pool->frames == NULL)
+        {
+            fprintf(stderr, "%s: Arena exhausted, allocating %d frames of %zu bytes from the heap\n", __func__, nframes, cap);
+            ucam_arena_rewind(arena, mark);
+        }
+    }
+    if (pool->frames == NULL)
+    {
+        pool->heap = 1;
+        pool->frames = (ucam_frame *)calloc(nframes, sizeof(ucam_frame));
+        if (pool->frames == NULL)
+            return -1;
+        for (int i = 0; i < nframes; i++)
+        {
+            pool->frames[i].data = (unsigned char *)malloc(cap);
+            if (pool->frames[i].data == NULL)
+            {
+                // the pool is not set up yet, undo by hand
+                while (i-- > 0)
+                    free(pool->frames[i].data);
+                free(pool->frames);
+                memset(pool, 0x0, sizeof(ucam_frame_pool));
+                return -1;
+            }
+        }
+    }
+    pool->nframes = nframes;
+    pool->cap = cap;
+    for (int i = nframes - 1; i >= 0; i--)
+    {
+        unsigned char *data = pool->frames[i].data;
+        memset(&(pool->frames[i]), 0x0, sizeof(ucam_frame));
+        pool->frames[i].data = data;
+        pool->frames[i].cap = cap;
+        pool->frames[i].pool = pool;
+        pool->frames[i].next = pool->free_list;
+        pool->free_list = &(pool->frames[i]);
+    }
+    pool->nfree = nframes;
+    pthread_mutex_init(&(pool->lock), NULL);
+    return 1;
+}
+
+void ucam_frame_pool_destroy(ucam_frame_pool *pool)
+{
+    if (pool == NULL || pool->frames == NULL)
+        return;
+    if (pool->nfree != pool->nframes)
+        fprintf(stderr, "%s: %d frames still referenced\n", __func__, pool->nframes - pool->nfree);
+    if (pool->heap)
+    {
+        for (int i = 0; i < pool->nframes; i++)
+            free(pool->frames[i].data);
+        free(pool->frames);
+    }
+    pthread_mutex_destroy(&(pool->lock));
+    memset(pool, 0x0, sizeof(ucam_frame_pool));
+}
+
+ucam_frame *ucam_frame_get(ucam_frame_pool *pool)
+{
+    pthread_mutex_lock(&(pool->lock));
+    ucam_frame *frame = pool->free_list;
+    if (frame != NULL)
+    {
+        pool->free_list = frame->next;
+        pool->nfree--;
+        frame->seq = pool->seq++;
+    }
+    pthread_mutex_unlock(&(pool->lock));
+    if (frame == NULL)
+        return NULL;
+    // clear the metadata, keep the buffer
+    unsigned char *data = frame->data;
+    size_t cap = frame->cap;
+    unsigned long long seq = frame->seq;
+    memset(frame, 0x0, sizeof(ucam_frame));
+    frame->data = data;
+    frame->cap = cap;
+    frame->seq = seq;
+    frame->pool = pool;
+    frame->refcnt = 1;
+    frame->sharpness = -1;
+    return frame;
+}
+
+ucam_frame *ucam_frame_ref(ucam_frame *frame)
+{
+    __atomic_add_fetch(&(frame->refcnt), 1, __ATOMIC_RELAXED);
+    return frame;
+}
+
+void ucam_frame_unref(ucam_frame *frame)
+{
+    if (frame == NULL)
+        return;
+    int refcnt = __atomic_sub_fetch(&(frame->refcnt), 1, __ATOMIC_ACQ_REL);
+    if (refcnt > 0)
+        return;
+    if (refcnt < 0)
+    {
+        fprintf(stderr, "%s: Frame %llu released too many times\n", __func__, frame->seq);
+        return;
+    }
+    ucam_frame_pool *pool = (ucam_frame_pool *)frame->pool;
+    pthread_mutex_lock(&(pool->lock));
+    frame->next = pool->free_list;
+    pool->free_list = frame;
+    pool->nfree++;
+    pthread_mutex_unlock(&(pool->lock));
+}
+
+void ucam_frame_stamp(struct timespec *ts)
+{
+    clock_gettime(CLOCK_MONOTONIC, ts);
+}
+
+double ucam_frame_elapsed(const struct timespec *start, const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e6 + (end->tv_nsec - start->tv_nsec) * 1e-3;
+}
+
+int ucam_frame_raw_dims(unsigned char raw_res, int *width, int *height)
+{
+    for (int i = 0; i < UCAM_FRAME_NRAW; i++)
+    {
+        if (ucam_frame_raw_res[i] == raw_res)
+        {
+            *width = ucam_frame_raw_width[i];
+            *height = ucam_frame_raw_height[i];
+            return 1;
+        }
+    }
+    return -1;
+}
+
+void ucam_frame_print(const ucam_frame *frame, FILE *fp)
+{
+    static const char *cksum_str[] = {"not checked", "pass", "FAIL"};
+    fprintf(fp, "Frame %llu: %zd bytes, fmt 0x%x raw 0x%x jpg 0x%x, C/B/E %d/%d/%d, light %d, pkg %d B\n",
+            frame->seq, frame->len, frame->img_fmt, frame->raw_res, frame->jpg_res,
+            frame->contrast, frame->brightness, frame->exposure, frame->light, frame->pkg_sz);
+    fprintf(fp, "    snap -> first byte %.1f ms, first -> last byte %.1f ms, %d packages, %d retries, checksum %s",
+            ucam_frame_elapsed(&(frame->t_snap), &(frame->t_first)) * 1e-3,
+            ucam_frame_elapsed(&(frame->t_first), &(frame->t_last)) * 1e-3,
+            frame->npkg, frame->retries, cksum_str[frame->cksum % 3]);
+    if (frame->cksum == UCAM_CKSUM_FAIL)
+        fprintf(fp, " (%d packages)", frame->cksum_err);
+    if (frame->sharpness >= 0)
+        fprintf(fp, ", sharpness %.3f", frame->sharpness);
+    if (frame->luma.nblocks > 0)
+        fprintf(fp, ", luma %.0f, %.1f%% clipped, %.1f%% crushed", frame->luma.mean, frame->luma.clipped * 100, frame->luma.crushed * 100);
+    fprintf(fp, "\n");
+}
@@ -0,0 +1,288 @@
+/**
+ * @file ucam_stack.c
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Registration and stacking of GRAY8 bursts for noise reduction.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <ucam_stack.h>
+#include <ucam.h>
+#include <stdio.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+
+#define UCAM_STACK_BLOCK 16 /// Pixels per inner loop, divides the width of every RAW frame
+
+void ucam_stack_init(ucam_stack *st)
+{
+    memset(st, 0x0, sizeof(ucam_stack));
+    st->max_shift = UCAM_STACK_MAX_SHIFT;
+    st->mad_ratio = UCAM_STACK_MAD_RATIO;
+}
+
+void ucam_stack_reset(ucam_stack *st)
+{
+    int max_shift = st->max_shift;
+    float mad_ratio = st->mad_ratio;
+    ucam_stack_init(st);
+    st->max_shift = max_shift;
+    st->mad_ratio = mad_ratio;
+}
+
+/**
+ * @brief Column and row sums of a frame in one pass.
+ *
+ */
+static void ucam_stack_sums(const unsigned char *restrict pix, int width, int height, unsigned int *restrict col, unsigned int *restrict row)
+{
+    memset(col, 0x0, width * sizeof(unsigned int));
+    for (int y = 0; y < height; y++)
+    {
+        const unsigned char *p = &(pix[y * width]);
+        unsigned int sum = 0;
+        for (int x = 0; x < width; x += UCAM_STACK_BLOCK)
+        {
+            unsigned short block = 0;
+            for (int j = 0; j < UCAM_STACK_BLOCK; j++)
+            {
+                col[x + j] += p[x + j];
+                block += p[x + j];
+            }
+            sum += block;
+        }
+        row[y] = sum;
+    }
+}
+
+/**
+ * @brief Standard deviation of the noise of a frame, from the mean absolute
+ * response to a Laplacian that cancels smooth intensity (Immerkaer, 1996). Edges
+ * add to it as well, so textured scenes read a little noisier than they are.
+ *
+ */
+static float ucam_stack_noise(const unsigned char *pix, int width, int height)
+{
+    double sum = 0;
+    for (int y = 1; y < height - 1; y++)
+    {
+        const unsigned char *a = &(pix[(y - 1) * width]), *b = &(pix[y * width]), *c = &(pix[(y + 1) * width]);
+        int x = 1;
+        for (; x + UCAM_STACK_BLOCK <= width - 1; x += UCAM_STACK_BLOCK)
+        {
+            const unsigned char *pa = &(a[x - 1]), *pb = &(b[x - 1]), *pc = &(c[x - 1]);
+            unsigned short block = 0; // 16 x 4080 at most
+            for (int j = 0; j < UCAM_STACK_BLOCK; j++)
+            {
+                short v = pa[j] - 2 * pa[j + 1] + pa[j + 2] - 2 * (pb[j] - 2 * pb[j + 1] + pb[j + 2]) + pc[j] - 2 * pc[j + 1] + pc[j + 2];
+                block += v < 0 ? -v : v;
+            }
+            sum += block;
+        }
+        for (; x < width - 1; x++)
+        {
+            int v = a[x - 1] - 2 * a[x] + a[x + 1] - 2 * (b[x - 1] - 2 * b[x] + b[x + 1]) + c[x - 1] - 2 * c[x] + c[x + 1];
+            sum += v < 0 ? -v : v;
+        }
+    }
+    return sqrt(M_PI / 2) * sum / (6.0 * (width - 2) * (height - 2));
+}
+
+/**
+ * @brief Shift d that best matches cur[i + d] to ref[i]. The mean difference
+ * over the overlap is taken out first, so a frame that is brighter as a whole
+ * (flicker, exposure) still lines up.
+ *
+ */
+static int ucam_stack_shift1d(const unsigned int *ref, const unsigned int *cur, int n, int max_shift)
+{
+    int best = 0;
+    double best_cost = DBL_MAX;
+    for (int d = -max_shift; d <= max_shift; d++)
+    {
+        int i0 = d < 0 ? -d : 0, i1 = d > 0 ? n - d : n;
+        double mean = 0, cost = 0;
+        for (int i = i0; i < i1; i++)
+            mean += (double)cur[i + d] - ref[i];
+        mean /= i1 - i0;
+        for (int i = i0; i < i1; i++)
+        {
+            double diff = (double)cur[i + d] - ref[i] - mean;
+            cost += diff < 0 ? -diff : diff;
+        }
+        cost /= i1 - i0;
+        if (cost < best_cost)
+        {
+            best_cost = cost;
+            best = d;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Sum of absolute differences between the reference and the frame
+ * shifted by (dx, dy), over the reference less a margin on every side.
+ *
+ */
+static unsigned int ucam_stack_sad(const unsigned char *restrict ref, const unsigned char *restrict pix, int width, int height, int margin, int dx, int dy)
+{
+    int n = width - 2 * margin;
+    unsigned int sad = 0;
+    for (int y = margin; y < height - margin; y++)
+    {
+        const unsigned char *a = &(ref[y * width + margin]);
+        const unsigned char *b = &(pix[(y + dy) * width + margin + dx]);
+        int x = 0;
+        for (; x + UCAM_STACK_BLOCK <= n; x += UCAM_STACK_BLOCK)
+        {
+            unsigned short block = 0;
+            for (int j = 0; j < UCAM_STACK_BLOCK; j++)
+            {
+                short d = a[x + j] - b[x + j];
+                block += d < 0 ? -d : d;
+            }
+            sad += block;
+        }
+        for (; x < n; x++)
+            sad += a[x] > b[x] ? a[x] - b[x] : b[x] - a[x];
+    }
+    return sad;
+}
+
+/**
+ * @brief Add n pixels to a row of the stack.
+ *
+ */
+static void ucam_stack_row(unsigned short *restrict acc, unsigned char *restrict cnt, const unsigned char *restrict pix, int n)
+{
+    int i = 0;
+    for (; i + UCAM_STACK_BLOCK <= n; i += UCAM_STACK_BLOCK)
+    {
+        for (int j = 0; j < UCAM_STACK_BLOCK; j++)
+        {
+            acc[i + j] += pix[i + j];
+            cnt[i + j]++;
+        }
+    }
+    for (; i < n; i++)
+    {
+        acc[i] += pix[i];
+        cnt[i]++;
+    }
+}
+
+int ucam_stack_add(ucam_stack *st, const ucam_frame *frame)
+{
+    int width, height;
+    if (frame->img_fmt != GRAY8 || ucam_frame_raw_dims(frame->raw_res, &width, &height) < 0)
+        return -1;
+    int npix = width * height;
+    if (frame->len != npix || st->nframes >= UCAM_STACK_MAX_FRAMES)
+        return -1;
+    if (st->nframes > 0 && (width != st->width || height != st->height))
+    {
+        fprintf(stderr, "%s: %d x %d frame in a %d x %d stack\n", __func__, width, height, st->width, st->height);
+        return -1;
+    }
+    struct timespec start, mid, end;
+    ucam_frame_stamp(&start);
+    if (st->nframes == 0) // reference
+    {
+        st->width = width;
+        st->height = height;
+        memcpy(st->ref, frame->data, npix);
+        ucam_stack_sums(st->ref, width, height, st->ref_col, st->ref_row);
+        // the difference of two aligned frames with independent noise of this
+        // level is normal with sqrt(2) times the deviation, whose mean absolute
+        // value is 2 / sqrt(pi) times the deviation of one frame
+        st->noise = ucam_stack_noise(st->ref, width, height);
+        st->mad_limit = st->mad_ratio * 2 / sqrt(M_PI) * st->noise + 1; // a gray level of slack for frames with no noise
+        ucam_frame_stamp(&mid);
+        for (int i = 0; i < npix; i++)
+            st->acc[i] = st->ref[i];
+        memset(st->cnt, 1, npix);
+        st->dx = st->dy = 0;
+        st->mad = 0;
+    }
+    else
+    {
+        // the margin keeps every candidate shift inside the frame
+        int max_shift = st->max_shift;
+        if (max_shift > height / 4)
+            max_shift = height / 4;
+        unsigned int col[UCAM_STACK_MAX_W], row[UCAM_STACK_MAX_H];
+        ucam_stack_sums(frame->data, width, height, col, row);
+        int dx = ucam_stack_shift1d(st->ref_col, col, width, max_shift);
+        int dy = ucam_stack_shift1d(st->ref_row, row, height, max_shift);
+        // the sums of a shifted frame cover slightly different pixels, walk
+        // down the difference to the nearest minimum
+        unsigned int best = ucam_stack_sad(st->ref, frame->data, width, height, max_shift, dx, dy);
+        for (int step = 0; step < 2 * max_shift; step++)
+        {
+            int cx = dx, cy = dy;
+            for (int ny = cy - 1; ny <= cy + 1; ny++)
+                for (int nx = cx - 1; nx <= cx + 1; nx++)
+                {
+                    if ((nx == cx && ny == cy) || nx < -max_shift || nx > max_shift || ny < -max_shift || ny > max_shift)
+                        continue;
+                    unsigned int sad = ucam_stack_sad(st->ref, frame->data, width, height, max_shift, nx, ny);
+                    if (sad < best)
+                    {
+                        best = sad;
+                        dx = nx;
+                        dy = ny;
+                    }
+                }
+            if (dx == cx && dy == cy)
+                break;
+        }
+        st->dx = dx;
+        st->dy = dy;
+        st->mad = (float)best / ((width - 2 * max_shift) * (height - 2 * max_shift));
+        ucam_frame_stamp(&mid);
+        if (st->mad > st->mad_limit)
+        {
+            st->nrejected++;
+            st->register_us += (ucam_frame_elapsed(&start, &mid) - st->register_us) / (st->nframes + st->nrejected);
+            return 0;
+        }
+        // pixel (x, y) of the reference is (x + dx, y + dy) of the frame
+        int x0 = dx < 0 ? -dx : 0, n = width - (dx < 0 ? -dx : dx);
+        for (int y = 0; y < height; y++)
+        {
+            if (y + dy < 0 || y + dy >= height)
+                continue;
+            ucam_stack_row(&(st->acc[y * width + x0]), &(st->cnt[y * width + x0]), &(frame->data[(y + dy) * width + x0 + dx]), n);
+        }
+    }
+    ucam_frame_stamp(&end);
+    st->nframes++;
+    st->register_us += (ucam_frame_elapsed(&start, &mid) - st->register_us) / (st->nframes + st->nrejected);
+    st->accumulate_us += (ucam_frame_elapsed(&mid, &end) - st->accumulate_us) / st->nframes;
+    return 1;
+}
+
+int ucam_stack_finish(ucam_stack *st)
+{
+    if (st->nframes == 0)
+        return -1;
+    struct timespec start, end;
+    ucam_frame_stamp(&start);
+    int npix = st->width * st->height;
+    for (int i = 0; i < npix; i++)
+        st->out[i] = (st->acc[i] + st->cnt[i] / 2) / st->cnt[i];
+    ucam_frame_stamp(&end);
+    st->finish_us = ucam_frame_elapsed(&start, &end);
+    return st->nframes;
+}
+
+void ucam_stack_print(const ucam_stack *st, FILE *fp)
+{
+    fprintf(fp, "Stack: %d x %d, %d frames, %d dropped, noise %.1f, last shift (%+d, %+d) difference %.1f of %.1f\n",
+            st->width, st->height, st->nframes, st->nrejected, st->noise, st->dx, st->dy, st->mad, st->mad_limit);
+    fprintf(fp, "    per frame: register %.1f us, accumulate %.1f us; finish %.1f us\n", st->register_us, st->accumulate_us, st->finish_us);
+}
@@ -0,0 +1,135 @@
+/**
+ * @file ucam_stats.c
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Per-resolution JPEG size and transfer time statistics.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <ucam_stats.h>
+#include <stdio.h>
+#include <string.h>
+
+static const unsigned char ucam_stats_res[UCAM_STATS_NRES] = {0x3, 0x5, 0x7}; // ucam_jpg_res
+static const int ucam_stats_width[UCAM_STATS_NRES] = {160, 320, 640};
+static const int ucam_stats_height[UCAM_STATS_NRES] = {128, 240, 480};
+
+void ucam_stats_init(ucam_jpg_stats *stats)
+{
+    memset(stats, 0x0, sizeof(ucam_jpg_stats));
+}
+
+int ucam_stats_index(unsigned char jpg_res)
+{
+    for (int i = 0; i < UCAM_STATS_NRES; i++)
+        if (ucam_stats_res[i] == jpg_res)
+            return i;
+    return -1;
+}
+
+int ucam_stats_dims(unsigned char jpg_res, int *width, int *height)
+{
+    int idx = ucam_stats_index(jpg_res);
+    if (idx < 0)
+        return -1;
+    *width = ucam_stats_width[idx];
+    *height = ucam_stats_height[idx];
+    return 1;
+}
+
+void ucam_stats_update(ucam_jpg_stats *stats, const ucam_frame *frame)
+{
+    int idx = ucam_stats_index(frame->jpg_res);
+    if (idx < 0 || frame->len <= 0)
+        return;
+    ucam_size_stats *st = &(stats->res[idx]);
+    st->count++;
+    st->mean += (frame->len - st->mean) / st->count;
+    if (frame->len > st->max)
+        st->max = frame->len;
+    double snap_us = ucam_frame_elapsed(&(frame->t_snap), &(frame->t_first));
+    double xfer_us = ucam_frame_elapsed(&(frame->t_first), &(frame->t_last));
+    st->snap_us += (snap_us - st->snap_us) / st->count;
+    st->xfer_us_per_byte += (xfer_us / frame->len - st->xfer_us_per_byte) / st->count;
+    int bin = frame->len / UCAM_STATS_BIN;
+    st->hist[bin < UCAM_STATS_NBINS ? bin : UCAM_STATS_NBINS - 1]++;
+}
+
+ssize_t ucam_stats_p99(const ucam_jpg_stats *stats, unsigned char jpg_res)
+{
+    int idx = ucam_stats_index(jpg_res);
+    if (idx < 0 || stats->res[idx].count == 0)
+        return 0;
+    const ucam_size_stats *st = &(stats->res[idx]);
+    unsigned long target = (st->count * 99 + 99) / 100; // ceil(0.99 * count)
+    unsigned long seen = 0;
+    for (int i = 0; i < UCAM_STATS_NBINS - 1; i++)
+    {
+        seen += st->hist[i];
+        if (seen >= target)
+            return (ssize_t)(i + 1) * UCAM_STATS_BIN;
+    }
+    return st->max; // p99 is in the overflow bin
+}
+
+size_t ucam_stats_bufsz(const ucam_jpg_stats *stats, unsigned char jpg_res)
+{
+    int idx = ucam_stats_index(jpg_res);
+    if (idx < 0)
+        idx = UCAM_STATS_NRES - 1; // unknown resolution, assume the largest
+    const ucam_size_stats *st = &(stats->res[idx]);
+    if (st->count == 0) // 6 bits per pixel is well above what the camera produces
+        return ucam_stats_width[idx] * ucam_stats_height[idx] * 3 / 4;
+    size_t sz = ucam_stats_p99(stats, jpg_res) * 5 / 4;
+    if (sz < (size_t)st->max)
+        sz = st->max;
+    return (sz + UCAM_STATS_BIN - 1) / UCAM_STATS_BIN * UCAM_STATS_BIN;
+}
+
+static double ucam_stats_wire_ms(ssize_t len, int baud, unsigned short pkg_sz)
+{
+    // every package carries 6 bytes of header and verify code and is answered by a 6 byte ACK
+    ssize_t npkg = (len + pkg_sz - 6 - 1) / (pkg_sz - 6);
+    double bits = (len + npkg * 12) * 10.0; // 8N1
+    return bits / baud * 1e3;
+}
+
+double ucam_stats_xfer_ms(const ucam_jpg_stats *stats, unsigned char jpg_res, int baud, unsigned short pkg_sz, double *p99_ms)
+{
+    int idx = ucam_stats_index(jpg_res);
+    if (idx < 0 || baud <= 0 || pkg_sz <= 6)
+        return -1;
+    const ucam_size_stats *st = &(stats->res[idx]);
+    double mean_ms, p99;
+    if (st->count == 0)
+    {
+        ssize_t len = ucam_stats_bufsz(stats, jpg_res);
+        mean_ms = ucam_stats_wire_ms(len, baud, pkg_sz);
+        p99 = mean_ms;
+    }
+    else
+    {
+        mean_ms = (st->snap_us + st->mean * st->xfer_us_per_byte) * 1e-3;
+        p99 = (st->snap_us + ucam_stats_p99(stats, jpg_res) * st->xfer_us_per_byte) * 1e-3;
+    }
+    if (p99_ms != NULL)
+        *p99_ms = p99;
+    return mean_ms;
+}
+
+void ucam_stats_print(const ucam_jpg_stats *stats, FILE *fp)
+{
+    fprintf(fp, "%-10s %8s %10s %10s %10s %10s %12s\n", "res", "frames", "mean B", "p99 B", "max B", "buffer B", "xfer us/B");
+    for (int i = 0; i < UCAM_STATS_NRES; i++)
+    {
+        const ucam_size_stats *st = &(stats->res[i]);
+        if (st->count == 0)
+            continue;
+        char res[16];
+        snprintf(res, sizeof(res), "%dx%d", ucam_stats_width[i], ucam_stats_height[i]);
+        fprintf(fp, "%-10s %8lu %10.0f %10zd %10zd %10zu %12.2f\n", res, st->count, st->mean,
+                ucam_stats_p99(stats, ucam_stats_res[i]), st->max, ucam_stats_bufsz(stats, ucam_stats_res[i]), st->xfer_us_per_byte);
+    }
+}
@@ -0,0 +1,111 @@
+/**
+ * @file ucam_watch.c
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Change detection on low resolution GRAY8 frames that triggers full resolution captures.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <ucam_watch.h>
+#include <ucam.h>
+#include <stdio.h>
+#include <string.h>
+
+#define UCAM_WATCH_BLOCK 16 /// Pixels compared per inner loop, divides every RAW frame size
+
+void ucam_watch_init(ucam_watch *w)
+{
+    memset(w, 0x0, sizeof(ucam_watch));
+    w->delta = UCAM_WATCH_DELTA;
+    w->on = UCAM_WATCH_ON;
+    w->off = UCAM_WATCH_OFF;
+}
+
+/**
+ * @brief Count the pixels that differ from the background by more than delta and
+ * move the background towards the frame, in one pass. Everything is 16 bit, and
+ * the pixels go in fixed blocks (every RAW size is a multiple of the block) so
+ * that the loop vectorizes at -O2 as well.
+ *
+ */
+static unsigned int ucam_watch_compare(short *restrict bg, const unsigned char *restrict pix, int npix, int delta)
+{
+    const short limit = delta << 4;
+    unsigned int changed = 0;
+    for (int i = 0; i < npix; i += UCAM_WATCH_BLOCK)
+    {
+        unsigned short count = 0;
+        for (int j = 0; j < UCAM_WATCH_BLOCK; j++)
+        {
+            short d = (short)(pix[i + j] << 4) - bg[i + j];
+            short ad = d < 0 ? -d : d;
+            count += ad > limit;
+            bg[i + j] += d >> UCAM_WATCH_BG_SHIFT;
+        }
+        changed += count;
+    }
+    return changed;
+}
+
+int ucam_watch_update(ucam_watch *w, const ucam_frame *frame)
+{
+    int width, height;
+    if (frame->img_fmt != GRAY8 || ucam_frame_raw_dims(frame->raw_res, &width, &height) < 0)
+        return -1;
+    int npix = width * height;
+    if (frame->len != npix)
+        return -1;
+    w->watch_bytes += frame->len;
+    w->watch_us += ucam_frame_elapsed(&(frame->t_snap), &(frame->t_last));
+    if (width != w->width || height != w->height) // new background
+    {
+        for (int i = 0; i < npix; i++)
+            w->bg[i] = frame->data[i] << 4;
+        w->width = width;
+        w->height = height;
+        w->score = 0;
+        w->armed = 1;
+        return 0;
+    }
+    struct timespec start, end;
+    ucam_frame_stamp(&start);
+    w->score = (float)ucam_watch_compare(w->bg, frame->data, npix, w->delta) / npix;
+    ucam_frame_stamp(&end);
+    w->nframes++;
+    w->compare_us += (ucam_frame_elapsed(&start, &end) - w->compare_us) / w->nframes;
+    if (w->score < w->off)
+        w->armed = 1;
+    if (!w->armed || w->score < w->on)
+        return 0;
+    w->armed = 0;
+    w->ntriggers++;
+    return 1;
+}
+
+void ucam_watch_full(ucam_watch *w, const ucam_frame *trigger, const ucam_frame *full)
+{
+    w->nfull++;
+    w->full_bytes += full->len > 0 ? full->len : 0;
+    w->full_us += ucam_frame_elapsed(&(trigger->t_last), &(full->t_last));
+    double latency = ucam_frame_elapsed(&(trigger->t_snap), &(full->t_last));
+    w->latency_us += (latency - w->latency_us) / w->nfull;
+    if (latency > w->latency_max_us)
+        w->latency_max_us = latency;
+}
+
+double ucam_watch_duty(const ucam_watch *w)
+{
+    double total = w->watch_us + w->full_us;
+    return total > 0 ? w->full_us / total : 0;
+}
+
+void ucam_watch_print(const ucam_watch *w, FILE *fp)
+{
+    unsigned long long bytes = w->watch_bytes + w->full_bytes;
+    fprintf(fp, "Watch: %lu frames, %lu triggers, %lu full frames, duty cycle %.1f%% of time and %.1f%% of bytes\n",
+            w->nframes, w->ntriggers, w->nfull, ucam_watch_duty(w) * 100, bytes > 0 ? 100.0 * w->full_bytes / bytes : 0);
+    fprintf(fp, "    change to full frame %.1f ms mean, %.1f ms max, %.1f us per comparison, last score %.3f\n",
+            w->latency_us * 1e-3, w->latency_max_us * 1e-3, w->compare_us, w->score);
+}